@@ -2,41 +2,143 @@
 #define _ARRAY_H_
 #include <string.h>
 
+template <bool> struct ArrayIndexCheck;
+template <> struct ArrayIndexCheck<true> {};
+
+// Fixed size array. Pass by reference - copying an array copies all of its
+// values through the stack.
+//
+// operator[] is bounds checked. An out of range index returns a reference to
+// a spare element, shared by all arrays of the same type, rather than to
+// memory outside of the array. Use getValue/setValue where the caller needs
+// to know about a bad index. get<i>() is unchecked at run time and rejects an
+// out of range index at compile time.
 template <class T, int size> class Array {
     public:
         Array();
-        Array(T value);
-        Array(T values[size]);
+        Array(const T &value);
+        Array(const T values[size]);
+
         T& operator[](int i);
+        const T& operator[](int i) const;
+
+        template <int i> T& get();
+        template <int i> const T& get() const;
+
+        bool getValue(int i, T &value) const;
+        bool setValue(int i, const T &value);
+
+        void fill(const T &value);
+        int getSize() const;
+
+        T* begin();
+        T* end();
+        const T* begin() const;
+        const T* end() const;
 
     private:
         T _values[size];
+        static T _spare;
 };
 
-template <class T, int size> 
-Array<T,size>::Array() {} 
+template <class T, int size>
+T Array<T,size>::_spare;
+
+template <class T, int size>
+Array<T,size>::Array() {}
 
 template <class T, int size>
-Array<T,size>::Array(T value) {
-    for (int i=0; i<size; i++) {
-        _values[i] = value;
-    }
+Array<T,size>::Array(const T &value) {
+    fill(value);
+}
+
+template <class T, int size>
+Array<T, size>::Array(const T values[size]) {
+    memcpy((void*) _values, (const void*) values, size*sizeof(T));
 }
 
 template <class T, int size>
-Array<T, size>::Array(T values[size]) {
-    memcpy((void*) _values, (void*) values, size*sizeof(T));
+inline T& Array<T, size>::operator[](int i) {
+    if ((i>=0) && (i<size)) {
+        return _values[i];
+    }
+    else {
+        return _spare;
+    }
 }
 
 template <class T, int size>
-T& Array<T, size>::operator[](int i) {
+inline const T& Array<T, size>::operator[](int i) const {
     if ((i>=0) && (i<size)) {
         return _values[i];
     }
     else {
-        T dummy;
-        return dummy;
+        return _spare;
     }
 }
 
+template <class T, int size>
+template <int i>
+inline T& Array<T, size>::get() {
+    (void) sizeof(ArrayIndexCheck<((i>=0) && (i<size))>);
+    return _values[i];
+}
+
+template <class T, int size>
+template <int i>
+inline const T& Array<T, size>::get() const {
+    (void) sizeof(ArrayIndexCheck<((i>=0) && (i<size))>);
+    return _values[i];
+}
+
+template <class T, int size>
+bool Array<T, size>::getValue(int i, T &value) const {
+    if ((i<0) || (i>=size)) {
+        return false;
+    }
+    value = _values[i];
+    return true;
+}
+
+template <class T, int size>
+bool Array<T, size>::setValue(int i, const T &value) {
+    if ((i<0) || (i>=size)) {
+        return false;
+    }
+    _values[i] = value;
+    return true;
+}
+
+template <class T, int size>
+void Array<T, size>::fill(const T &value) {
+    for (int i=0; i<size; i++) {
+        _values[i] = value;
+    }
+}
+
+template <class T, int size>
+inline int Array<T, size>::getSize() const {
+    return size;
+}
+
+template <class T, int size>
+inline T* Array<T, size>::begin() {
+    return _values;
+}
+
+template <class T, int size>
+inline T* Array<T, size>::end() {
+    return _values + size;
+}
+
+template <class T, int size>
+inline const T* Array<T, size>::begin() const {
+    return _values;
+}
+
+template <class T, int size>
+inline const T* Array<T, size>::end() const {
+    return _values + size;
+}
+
 #endif
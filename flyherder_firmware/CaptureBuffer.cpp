@@ -0,0 +1,71 @@
+#include <util/atomic.h>
+#if defined(ARDUINO) && ARDUINO >= 100
+#include "Arduino.h"
+#else
+#include "WProgram.h"
+#endif
+#include "CaptureBuffer.h"
+
+CaptureBuffer::CaptureBuffer() {
+    clear();
+}
+
+void CaptureBuffer::clear() {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        _head = 0;
+        _count = 0;
+        _lost = 0;
+        _lastEdgeTime = 0;
+        _edgeSeen = false;
+    }
+}
+
+void CaptureBuffer::add(long position, unsigned long time, char edge) {
+    // Called from the home input interrupt.
+    bool bounce = _edgeSeen && (time - _lastEdgeTime < constants::captureDebounceTime);
+    _lastEdgeTime = time;
+    _edgeSeen = true;
+    if (bounce) {
+        return;
+    }
+    uint8_t ind = (_head + _count) % constants::captureBufferSize;
+    if (_count < constants::captureBufferSize) {
+        _count++;
+    }
+    else {
+        _head = (_head + 1) % constants::captureBufferSize;
+        if (_lost < 0xffff) {
+            _lost++;
+        }
+    }
+    _buffer[ind].position = position;
+    _buffer[ind].time = time;
+    _buffer[ind].edge = edge;
+}
+
+bool CaptureBuffer::get(PositionCapture &capture) {
+    // Removes the oldest capture. Returns false if there is none.
+    bool flag = false;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        if (_count > 0) {
+            capture = _buffer[_head];
+            _head = (_head + 1) % constants::captureBufferSize;
+            _count--;
+            flag = true;
+        }
+    }
+    return flag;
+}
+
+uint8_t CaptureBuffer::getCount() {
+    return _count;
+}
+
+uint16_t CaptureBuffer::getLostAndClear() {
+    uint16_t lost;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        lost = _lost;
+        _lost = 0;
+    }
+    return lost;
+}
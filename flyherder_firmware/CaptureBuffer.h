@@ -0,0 +1,40 @@
+// CaptureBuffer.h
+#ifndef _CAPTURE_BUFFER_H_
+#define _CAPTURE_BUFFER_H_
+
+#include <stdint.h>
+#include "constants.h"
+
+// Step count and time latched by an edge of an axis' home input.
+struct PositionCapture {
+    long position;          // Steps
+    unsigned long time;     // us, from micros()
+    char edge;              // 'F' switch closed (falling), 'R' switch opened 
+};
+
+// Fixed size queue of position captures. Captures are added from the home 
+// input interrupts and read from the main loop. When the queue is full the 
+// oldest capture is overwritten and counted as lost. An edge less than 
+// constants::captureDebounceTime after the previous edge, captured or not, 
+// is switch bounce and is not added, so only the first edge of a burst is.
+class CaptureBuffer {
+
+    public:
+        CaptureBuffer();
+
+        void clear();
+        void add(long position, unsigned long time, char edge);
+        bool get(PositionCapture &capture);
+        uint8_t getCount();
+        uint16_t getLostAndClear();
+
+    private:
+        PositionCapture _buffer[constants::captureBufferSize];
+        volatile uint8_t _head;
+        volatile uint8_t _count;
+        volatile uint16_t _lost;
+        unsigned long _lastEdgeTime;
+        bool _edgeSeen;
+};
+
+#endif
@@ -0,0 +1,309 @@
+#include <string.h>
+#include <limits.h>
+#if defined(ARDUINO) && ARDUINO >= 100
+#include "Arduino.h"
+#else
+#include "WProgram.h"
+#endif
+#include "CommandParser.h"
+
+// Significant digits kept when parsing a number, the most that fit in a long
+enum {PARSER_MAX_DIGITS=9};
+
+CommandParser::CommandParser() {
+    reset();
+}
+
+void CommandParser::process(int c) {
+    if (c == '[') {
+        reset();
+        _inMessage = true;
+        return;
+    }
+    if (!_inMessage) {
+        return;
+    }
+    switch (c) {
+        case ']':
+            if (_itemOpen || (_numItems > 0)) {
+                endItem();
+            }
+            _inMessage = false;
+            if (_overflow) {
+                reset();
+            }
+            else {
+                _ready = true;
+            }
+            break;
+
+        case ',':
+            endItem();
+            break;
+
+        case ' ':
+        case '\t':
+        case '\r':
+        case '\n':
+            break;
+
+        default:
+            // One byte is kept free for the item's terminating null
+            if (_len >= PARSER_BUF_SZ-1) {
+                _overflow = true;
+                return;
+            }
+            if (!_itemOpen) {
+                if (_numItems >= PARSER_MAX_ITEMS) {
+                    _overflow = true;
+                    return;
+                }
+                _itemStart[_numItems] = _len;
+                _itemOpen = true;
+            }
+            _buf[_len++] = c;
+            break;
+    }
+}
+
+bool CommandParser::messageReady() {
+    return _ready;
+}
+
+void CommandParser::reset() {
+    _len = 0;
+    _numItems = 0;
+    _inMessage = false;
+    _itemOpen = false;
+    _ready = false;
+    _overflow = false;
+}
+
+int CommandParser::numberOfItems() {
+    return _numItems;
+}
+
+int CommandParser::itemLength(int item) {
+    return strlen(itemStr(item));
+}
+
+const char *CommandParser::itemStr(int item) {
+    if ((item < 0) || (item >= _numItems)) {
+        return "";
+    }
+    return &_buf[_itemStart[item]];
+}
+
+int CommandParser::readInt(int item) {
+    return (int) readLong(item);
+}
+
+long CommandParser::readLong(int item) {
+    // Any fractional part is truncated, as by atol. A value too large for a
+    // long is limited to LONG_MAX or LONG_MIN, see isLong.
+    long mantissa;
+    int exponent;
+    long value;
+    if (!readDecimal(item, mantissa, exponent)) {
+        return 0;
+    }
+    scaleLong(mantissa, exponent, value);
+    return value;
+}
+
+float CommandParser::readFloat(int item) {
+    // A single multiply or divide by an exact power of ten, so there is one
+    // rounding for numbers of up to 9 significant digits and |exponent| <= 9.
+    long mantissa;
+    int exponent;
+    float value;
+    if (!readDecimal(item, mantissa, exponent)) {
+        return 0.0;
+    }
+    value = (float) mantissa;
+    while (exponent != 0) {
+        int step = exponent;
+        if (step > PARSER_MAX_DIGITS) {
+            step = PARSER_MAX_DIGITS;
+        }
+        else if (step < -PARSER_MAX_DIGITS) {
+            step = -PARSER_MAX_DIGITS;
+        }
+        int num = (step > 0) ? step : -step;
+        long scale = 1;
+        for (int i=0; i<num; i++) {
+            scale *= 10;
+        }
+        if (step > 0) {
+            value *= (float) scale;
+        }
+        else {
+            value /= (float) scale;
+        }
+        exponent -= step;
+    }
+    return value;
+}
+
+double CommandParser::readDouble(int item) {
+    return readFloat(item);
+}
+
+char CommandParser::readChar(int item, int pos) {
+    if ((pos < 0) || (pos >= itemLength(item))) {
+        return '\0';
+    }
+    return itemStr(item)[pos];
+}
+
+void CommandParser::copyString(int item, char *str, int size) {
+    if (size <= 0) {
+        return;
+    }
+    strncpy(str, itemStr(item), size-1);
+    str[size-1] = '\0';
+}
+
+bool CommandParser::itemEquals(int item, const char *str) {
+    return strcmp(itemStr(item), str) == 0;
+}
+
+uint8_t CommandParser::itemHash(int item) {
+    return nameHash(itemStr(item));
+}
+
+bool CommandParser::isNumber(int item) {
+    // True if the whole item is a number, as read by readFloat
+    long mantissa;
+    int exponent;
+    const char *end;
+    return readDecimal(item, mantissa, exponent, &end) && (*end == '\0');
+}
+
+bool CommandParser::isLong(int item) {
+    // True if the whole item is a number which readLong can return without
+    // limiting it.
+    long mantissa;
+    int exponent;
+    long value;
+    const char *end;
+    if (!readDecimal(item, mantissa, exponent, &end) || (*end != '\0')) {
+        return false;
+    }
+    return scaleLong(mantissa, exponent, value);
+}
+
+uint8_t CommandParser::nameHash(const char *name) {
+    // Cheap hash of a short name, e.g. an axis name, for table lookups. For
+    // the axis names x0, y0, x1 and y1 the low 3 bits are all different.
+    uint8_t hash = 0;
+    while (*name) {
+        hash = 3*hash + *name++;
+    }
+    return hash;
+}
+
+void CommandParser::endItem() {
+    // Terminates the current item. An empty item, e.g. between two commas,
+    // is recorded as an empty string.
+    if (!_itemOpen) {
+        if (_numItems >= PARSER_MAX_ITEMS) {
+            _overflow = true;
+            return;
+        }
+        _itemStart[_numItems] = _len;
+    }
+    if (_len >= PARSER_BUF_SZ) {
+        _overflow = true;
+        return;
+    }
+    _buf[_len++] = '\0';
+    _numItems++;
+    _itemOpen = false;
+}
+
+bool CommandParser::scaleLong(long mantissa, int exponent, long &value) {
+    // Sets value to mantissa*10^exponent with any fractional part truncated.
+    // Returns false, with value at LONG_MAX or LONG_MIN, if it would not fit.
+    for (; exponent > 0; exponent--) {
+        if ((mantissa > LONG_MAX/10) || (mantissa < LONG_MIN/10)) {
+            value = (mantissa > 0) ? LONG_MAX : LONG_MIN;
+            return false;
+        }
+        mantissa *= 10;
+    }
+    for (; (exponent < 0) && (mantissa != 0); exponent++) {
+        mantissa /= 10;
+    }
+    value = mantissa;
+    return true;
+}
+
+bool CommandParser::readDecimal(int item, long &mantissa, int &exponent, const char **end) {
+    // Parses [+-]digits[.digits][(e|E)[+-]digits] into an integer mantissa
+    // and a power of ten. Digits past PARSER_MAX_DIGITS significant digits
+    // are dropped. Returns false if there are no digits. If end is given it
+    // is set to the first character not parsed.
+    const char *s = itemStr(item);
+    bool negative = false;
+    bool point = false;
+    bool digits = false;
+    uint8_t numSig = 0;
+    mantissa = 0;
+    exponent = 0;
+    if ((*s == '-') || (*s == '+')) {
+        negative = (*s == '-');
+        s++;
+    }
+    for (;; s++) {
+        if ((*s >= '0') && (*s <= '9')) {
+            digits = true;
+            if (numSig < PARSER_MAX_DIGITS) {
+                mantissa = 10*mantissa + (*s - '0');
+                if (mantissa != 0) {
+                    numSig++;
+                }
+                if (point) {
+                    exponent--;
+                }
+            }
+            else if (!point) {
+                exponent++;
+            }
+        }
+        else if ((*s == '.') && !point) {
+            point = true;
+        }
+        else {
+            break;
+        }
+    }
+    if (digits && ((*s == 'e') || (*s == 'E'))) {
+        const char *e = s;
+        bool expNegative = false;
+        int expValue = 0;
+        s++;
+        if ((*s == '-') || (*s == '+')) {
+            expNegative = (*s == '-');
+            s++;
+        }
+        if ((*s >= '0') && (*s <= '9')) {
+            for (; (*s >= '0') && (*s <= '9'); s++) {
+                if (expValue < 100) {
+                    expValue = 10*expValue + (*s - '0');
+                }
+            }
+            exponent += expNegative ? -expValue : expValue;
+        }
+        else {
+            s = e;
+        }
+    }
+    if (negative) {
+        mantissa = -mantissa;
+    }
+    if (end != 0) {
+        *end = s;
+    }
+    return digits;
+}
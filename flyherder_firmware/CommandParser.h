@@ -0,0 +1,64 @@
+// CommandParser.h
+#ifndef _COMMAND_PARSER_H_
+#define _COMMAND_PARSER_H_
+
+#include <stdint.h>
+
+enum {
+    PARSER_BUF_SZ=128,
+    PARSER_MAX_ITEMS=16,
+};
+
+// Receives command messages, [item,item,...], one byte at a time. Used in
+// place of the SerialReceiver library, with the same interface, so that the
+// arguments are parsed without atof or copying.
+//
+// The message is split as it arrives: each item is stored null terminated in
+// the buffer, with white space dropped, and its offset recorded, so reading
+// an item needs no search. Numbers are parsed as a decimal integer and power
+// of ten, e.g. 12.5e-1 as 125 and -2, and readFloat only converts the result.
+//
+// A message longer than the buffer, or with more than PARSER_MAX_ITEMS items,
+// is dropped.
+class CommandParser {
+
+    public:
+        CommandParser();
+
+        void process(int c);
+        bool messageReady();
+        void reset();
+
+        int numberOfItems();
+        int itemLength(int item);
+        const char *itemStr(int item);
+
+        int readInt(int item);
+        long readLong(int item);
+        float readFloat(int item);
+        double readDouble(int item);
+        char readChar(int item, int pos);
+        void copyString(int item, char *str, int size);
+        bool itemEquals(int item, const char *str);
+        uint8_t itemHash(int item);
+        bool isNumber(int item);
+        bool isLong(int item);
+
+        static uint8_t nameHash(const char *name);
+
+    private:
+        char _buf[PARSER_BUF_SZ];
+        uint8_t _itemStart[PARSER_MAX_ITEMS];
+        uint8_t _len;
+        uint8_t _numItems;
+        bool _inMessage;
+        bool _itemOpen;
+        bool _ready;
+        bool _overflow;
+
+        void endItem();
+        bool readDecimal(int item, long &mantissa, int &exponent, const char **end=0);
+        static bool scaleLong(long mantissa, int exponent, long &value);
+};
+
+#endif
@@ -0,0 +1,128 @@
+// CommandTable.h
+#ifndef _COMMAND_TABLE_H_
+#define _COMMAND_TABLE_H_
+
+// The serial commands, in command id order. Each entry is
+//
+//     CMD(Name, "name", "args")
+//
+// which gives the command id cmdName, the handler MessageHandler::handleName
+// and the name reported by getCmds. The command enum, handler declarations,
+// dispatch, argument checks, getCmds and getCmdArgs are all generated from
+// this list, so a new command only needs its entry here and its handler.
+//
+// "args" has one character for each argument after the command id:
+//
+//     f - number
+//     i - integer, a number whose fractional part is dropped, within the
+//         range of a long
+//     a - axis name
+//     c - character, the first character of the argument
+//
+// A '*' after the last character allows any number of that argument,
+// including none. The arguments are checked before the handler is called.
+// The strings are written out for constants::numAxis = 4 and
+// constants::numDim = 2.
+#ifdef HAVE_ENABLE
+#define ENABLE_COMMANDS(CMD) \
+    CMD(Enable,                 "enable",                 "") \
+    CMD(Disable,                "disable",                "") \
+    CMD(IsEnabled,              "isEnabled",              "")
+#else
+#define ENABLE_COMMANDS(CMD)
+#endif
+
+#define COMMAND_TABLE(CMD) \
+    CMD(GetDevInfo,             "getDevInfo",             "") \
+    CMD(GetCmds,                "getCmds",                "") \
+    CMD(GetRspCodes,            "getRspCodes",            "") \
+    \
+    CMD(GetNumAxis,             "getNumAxis",             "") \
+    CMD(GetNumDim,              "getNumDim",              "") \
+    CMD(GetAxisNames,           "getAxisNames",           "") \
+    CMD(GetDimNames,            "getDimNames",            "") \
+    CMD(GetAxisOrder,           "getAxisOrder",           "") \
+    CMD(GetDimOrder,            "getDimOrder",            "") \
+    CMD(GetAllowedOrientation,  "getAllowedOrientation",  "") \
+    \
+    CMD(SetDrivePowerOn,        "setDrivePowerOn",        "") \
+    CMD(SetDrivePowerOff,       "setDrivePowerOff",       "") \
+    CMD(IsDrivePowerOn,         "isDrivePowerOn",         "") \
+    CMD(IsDriveReady,           "isDriveReady",           "") \
+    CMD(GetFaultStatus,         "getFaultStatus",         "") \
+    CMD(ClearFault,             "clearFault",             "") \
+    \
+    CMD(Stop,                   "stop",                   "") \
+    CMD(IsRunning,              "isRunning",              "") \
+    ENABLE_COMMANDS(CMD) \
+    \
+    CMD(MoveToPosition,         "moveToPosition",         "ffff") \
+    CMD(ArmMove,                "armMove",                "ffff") \
+    CMD(IsArmed,                "isArmed",                "") \
+    CMD(CancelArmed,            "cancelArmed",            "") \
+    CMD(SetTrigger,             "setTrigger",             "ic") \
+    CMD(GetTrigger,             "getTrigger",             "") \
+    CMD(MoveAxisToPosition,     "moveAxisToPosition",     "af") \
+    CMD(MoveToPositionInTime,   "moveToPositionInTime",   "fffff") \
+    CMD(MoveArc,                "moveArc",                "ifff") \
+    CMD(MoveBezier,             "moveBezier",             "iffffff") \
+    CMD(AddPathPoint,           "addPathPoint",           "ffff") \
+    CMD(GetPathFree,            "getPathFree",            "") \
+    CMD(MoveToHome,             "moveToHome",             "") \
+    CMD(MoveAxisToHome,         "moveAxisToHome",         "a") \
+    CMD(IsInHomePosition,       "isInHomePosition",       "") \
+    \
+    CMD(GetPosition,            "getPosition",            "") \
+    CMD(GetAxisPosition,        "getAxisPosition",        "a") \
+    CMD(GetPositionSteps,       "getPositionSteps",       "") \
+    CMD(GetAxisPositionSteps,   "getAxisPositionSteps",   "a") \
+    CMD(GetSnapshot,            "getSnapshot",            "") \
+    CMD(GetCaptures,            "getCaptures",            "a") \
+    CMD(SetCompareOutput,       "setCompareOutput",       "ii") \
+    CMD(LoadCompareTable,       "loadCompareTable",       "af*") \
+    CMD(SetCompareInterval,     "setCompareInterval",     "ai") \
+    CMD(ArmCompare,             "armCompare",             "") \
+    CMD(ClearCompare,           "clearCompare",           "") \
+    CMD(GetCompareStatus,       "getCompareStatus",       "") \
+    CMD(SetPosition,            "setPosition",            "ffff") \
+    CMD(SetAxisPosition,        "setAxisPosition",        "af") \
+    CMD(GetStoredPosition,      "getStoredPosition",      "") \
+    CMD(AcceptStoredPosition,   "acceptStoredPosition",   "") \
+    CMD(RejectStoredPosition,   "rejectStoredPosition",   "") \
+    \
+    CMD(SetMaxSeparation,       "setMaxSeparation",       "ff") \
+    CMD(GetMaxSeparation,       "getMaxSeparation",       "") \
+    \
+    CMD(SetSpeed,               "setSpeed",               "f") \
+    CMD(GetSpeed,               "getSpeed",               "") \
+    CMD(GetFeedOverride,        "getFeedOverride",        "") \
+    CMD(SetAcceleration,        "setAcceleration",        "f") \
+    CMD(GetAcceleration,        "getAcceleration",        "") \
+    CMD(SetJunctionDeviation,   "setJunctionDeviation",   "f") \
+    CMD(GetJunctionDeviation,   "getJunctionDeviation",   "") \
+    \
+    CMD(SetOrientation,         "setOrientation",         "cccc") \
+    CMD(GetOrientation,         "getOrientation",         "") \
+    \
+    CMD(SetAxisOrientation,     "setAxisOrientation",     "ac") \
+    CMD(GetAxisOrientation,     "getAxisOrientation",     "a") \
+    \
+    CMD(SetStepsPerMM,          "setStepsPerMM",          "f") \
+    CMD(GetStepsPerMM,          "getStepsPerMM",          "") \
+    \
+    CMD(EnableBoundsCheck,      "enableBoundsCheck",      "") \
+    CMD(DisableBoundsCheck,     "disableBoundsCheck",     "") \
+    CMD(IsBoundsCheckEnabled,   "isBoundsCheckEnabled",   "") \
+    \
+    CMD(SetSerialNumber,        "setSerialNumber",        "i*") \
+    CMD(GetSerialNumber,        "getSerialNumber",        "") \
+    \
+    CMD(GetModelNumber,         "getModelNumber",         "") \
+    \
+    CMD(GetSerialStats,         "getSerialStats",         "") \
+    CMD(GetCmdArgs,             "getCmdArgs",             "") \
+    \
+    /* DEVELOPMENT */ \
+    CMD(Debug,                  "cmdDebug",               "")
+
+#endif
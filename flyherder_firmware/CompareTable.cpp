@@ -0,0 +1,66 @@
+#if defined(ARDUINO) && ARDUINO >= 100
+#include "Arduino.h"
+#else
+#include "WProgram.h"
+#endif
+#include "CompareTable.h"
+
+CompareTable::CompareTable() {
+    clear();
+}
+
+void CompareTable::clear() {
+    // Should not be called while the table is armed
+    _count = 0;
+    _index = 0;
+    _interval = 0;
+    _intervalCount = 0;
+}
+
+bool CompareTable::load(const long *position, uint8_t num) {
+    // Loads the compare positions, which must be in increasing order. Should
+    // not be called while the table is armed.
+    if (num > constants::compareTableSize) {
+        return false;
+    }
+    for (uint8_t i=1; i<num; i++) {
+        if (position[i] <= position[i-1]) {
+            return false;
+        }
+    }
+    for (uint8_t i=0; i<num; i++) {
+        _position[i] = position[i];
+    }
+    _count = num;
+    _index = 0;
+    return true;
+}
+
+void CompareTable::setInterval(long interval) {
+    // Pulse every interval steps, 0 for none. Should not be called while the
+    // table is armed.
+    _interval = (interval > 0) ? interval : 0;
+    _intervalCount = 0;
+}
+
+void CompareTable::arm(long position) {
+    // Sets the index from the current axis position. Should be called with
+    // the axis stopped or in an atomic block.
+    _index = 0;
+    while ((_index < _count) && (_position[_index] <= position)) {
+        _index++;
+    }
+    _intervalCount = 0;
+}
+
+uint8_t CompareTable::getCount() {
+    return _count;
+}
+
+long CompareTable::getInterval() {
+    return _interval;
+}
+
+bool CompareTable::isEmpty() {
+    return (_count == 0) && (_interval == 0);
+}
@@ -0,0 +1,73 @@
+// CompareTable.h
+#ifndef _COMPARE_TABLE_H_
+#define _COMPARE_TABLE_H_
+
+#include <stdint.h>
+#include "constants.h"
+
+// Positions (steps) at which an axis fires a compare output pulse, and an
+// optional pulse every N steps travelled. Loaded and armed from the main 
+// loop and checked by the timer interrupt on each step of the axis.
+//
+// The positions are kept in increasing order with an index giving the number
+// of them at or below the axis position, so each step needs a single compare
+// whichever way the axis is moving. A pulse fires when the axis steps onto a
+// position from either side.
+class CompareTable {
+
+    public:
+        CompareTable();
+
+        void clear();
+        bool load(const long *position, uint8_t num);
+        void setInterval(long interval);
+        void arm(long position);
+
+        uint8_t getCount();
+        long getInterval();
+        bool isEmpty();
+
+        bool stepUp(long position);
+        bool stepDown(long position);
+
+    private:
+        long _position[constants::compareTableSize];
+        uint8_t _count;
+        uint8_t _index;
+        long _interval;
+        long _intervalCount;
+};
+
+inline bool CompareTable::stepUp(long position) {
+    // Called from the timer interrupt after a step in the positive direction
+    // to position. Returns true if a pulse is due.
+    bool fire = false;
+    if ((_index < _count) && (_position[_index] == position)) {
+        _index++;
+        fire = true;
+    }
+    if ((_interval > 0) && (++_intervalCount >= _interval)) {
+        _intervalCount = 0;
+        fire = true;
+    }
+    return fire;
+}
+
+inline bool CompareTable::stepDown(long position) {
+    // Called from the timer interrupt after a step in the negative direction
+    // to position. Returns true if a pulse is due.
+    bool fire = false;
+    if ((_index > 0) && (_position[_index-1] == position+1)) {
+        _index--;
+    }
+    if ((_index > 0) && (_position[_index-1] == position)) {
+        fire = true;
+    }
+    if ((_interval > 0) && (++_intervalCount >= _interval)) {
+        _intervalCount = 0;
+        fire = true;
+    }
+    return fire;
+}
+
+#endif
@@ -0,0 +1,134 @@
+#if defined(ARDUINO) && ARDUINO >= 100
+#include "Arduino.h"
+#else
+#include "WProgram.h"
+#endif
+#include "CurveGen.h"
+
+// Target length of the chords, in steps, used to approximate the curves. The
+// chords are run by the steppers' rate dividers so that the dominant axis of
+// each chord moves at the set speed.
+const float chordSteps = 2.0;
+const long maxBezierPts = 4096;
+const int maxArcShift = 30;
+const long CurveGen::maxExtent = 65536;
+
+CurveGen::CurveGen() {
+    clear();
+}
+
+void CurveGen::clear() {
+    _mode = modeNone;
+    _ccw = true;
+    _shift = 0;
+    _count = 0;
+    _numPts = 0;
+    _xOrigin = 0;
+    _yOrigin = 0;
+    _xEnd = 0;
+    _yEnd = 0;
+    _x = 0;
+    _y = 0;
+    _dx1 = 0;
+    _dx2 = 0;
+    _dx3 = 0;
+    _dy1 = 0;
+    _dy2 = 0;
+    _dy3 = 0;
+}
+
+void CurveGen::setArc(long x0, long y0, long xc, long yc, float angle) {
+    // Arc starting at (x0,y0) about the center (xc,yc). The angle is in radians,
+    // positive values are counter clockwise.
+    float dx = (float) (x0 - xc);
+    float dy = (float) (y0 - yc);
+    float radius = sqrt(dx*dx + dy*dy);
+    float angle0 = atan2(dy,dx);
+    float delta;
+    int shift = 0;
+
+    clear();
+    _xOrigin = xc;
+    _yOrigin = yc;
+    _xEnd = xc + (long) floor(radius*cos(angle0 + angle) + 0.5);
+    _yEnd = yc + (long) floor(radius*sin(angle0 + angle) + 0.5);
+    _ccw = (angle >= 0);
+
+    // Pick the rotation per point, 2^-shift radians, so that the chords are
+    // no longer than chordSteps.
+    while ((radius > chordSteps*((float) (1L << shift))) && (shift < maxArcShift)) {
+        shift++;
+    }
+    _shift = shift;
+    delta = 1.0/((float) (1L << shift));
+    delta = delta*(1.0 + delta*delta/24.0);
+    _numPts = ((long) (fabs(angle)/delta + 0.5)) - 1;
+    if (_numPts < 0) {
+        _numPts = 0;
+    }
+    _x = ((int64_t) (x0 - xc))*(((int64_t) 1) << fracBits);
+    _y = ((int64_t) (y0 - yc))*(((int64_t) 1) << fracBits);
+    _mode = modeArc;
+}
+
+void CurveGen::setBezier(
+        long x0, long y0,
+        long x1, long y1,
+        long x2, long y2,
+        long x3, long y3
+        )
+{
+    // Cubic Bezier curve with control points (x0,y0) ... (x3,y3). Points are
+    // generated by forward differencing with numPts+1 equal steps in the curve
+    // parameter.
+    int64_t one = ((int64_t) 1) << fracBits;
+    int64_t ax, bx, cx, ay, by, cy;
+    int64_t n1, n2, n3;
+    long polyLen;
+
+    clear();
+    _xOrigin = x0;
+    _yOrigin = y0;
+    _xEnd = x3;
+    _yEnd = y3;
+
+    // Number of points from the length of the control polygon which bounds
+    // the length of the curve.
+    polyLen = max(labs(x1-x0), labs(y1-y0));
+    polyLen += max(labs(x2-x1), labs(y2-y1));
+    polyLen += max(labs(x3-x2), labs(y3-y2));
+    n1 = (int64_t) ceil(((float) polyLen)/chordSteps);
+    if (n1 < 1) {
+        n1 = 1;
+    }
+    if (n1 > maxBezierPts) {
+        n1 = maxBezierPts;
+    }
+    n2 = n1*n1;
+    n3 = n2*n1;
+
+    // Polynomial coefficients relative to the start point
+    ax = ((int64_t) (3*(x1-x0) - 3*(x2-x0) + (x3-x0)))*one;
+    bx = ((int64_t) (3*(x2-x0) - 6*(x1-x0)))*one;
+    cx = ((int64_t) (3*(x1-x0)))*one;
+    ay = ((int64_t) (3*(y1-y0) - 3*(y2-y0) + (y3-y0)))*one;
+    by = ((int64_t) (3*(y2-y0) - 6*(y1-y0)))*one;
+    cy = ((int64_t) (3*(y1-y0)))*one;
+
+    _dx1 = ax/n3 + bx/n2 + cx/n1;
+    _dx2 = 6*ax/n3 + 2*bx/n2;
+    _dx3 = 6*ax/n3;
+    _dy1 = ay/n3 + by/n2 + cy/n1;
+    _dy2 = 6*ay/n3 + 2*by/n2;
+    _dy3 = 6*ay/n3;
+    _numPts = (long) (n1 - 1);
+    _mode = modeBezier;
+}
+
+long CurveGen::getEndX() {
+    return _xEnd;
+}
+
+long CurveGen::getEndY() {
+    return _yEnd;
+}
@@ -0,0 +1,104 @@
+// CurveGen.h
+#ifndef _CURVE_GEN_H_
+#define _CURVE_GEN_H_
+
+#include <stdint.h>
+
+// Generates the points of a circular arc or a cubic Bezier curve for a single
+// herder (x/y axis pair). Curves are loaded from the main loop and points are
+// produced one at a time from the step timer interrupt using only fixed point
+// adds and shifts.
+class CurveGen {
+
+    public:
+        // Largest allowed distance (steps) between the control points or from 
+        // the start point to the arc center.
+        static const long maxExtent;
+
+        CurveGen();
+
+        void setArc(long x0, long y0, long xc, long yc, float angle);
+        void setBezier(long x0, long y0, long x1, long y1, long x2, long y2, long x3, long y3);
+        void clear();
+
+        bool isActive();
+        long getEndX();
+        long getEndY();
+        bool next(long &x, long &y);
+
+    private:
+
+        enum {modeNone, modeArc, modeBezier};
+        enum {fracBits=40};
+
+        volatile uint8_t _mode;
+        bool _ccw;
+        uint8_t _shift;
+        long _count;
+        long _numPts;
+        long _xOrigin;     // Arc center or Bezier start point (steps)
+        long _yOrigin;
+        long _xEnd;
+        long _yEnd;
+        int64_t _x;        // Position relative to origin (fixed point)
+        int64_t _y;
+        int64_t _dx1;      // Bezier forward differences (fixed point)
+        int64_t _dx2;
+        int64_t _dx3;
+        int64_t _dy1;
+        int64_t _dy2;
+        int64_t _dy3;
+
+        long roundFixed(int64_t value);
+};
+
+inline bool CurveGen::isActive() {
+    return _mode != modeNone;
+}
+
+inline long CurveGen::roundFixed(int64_t value) {
+    return (long) ((value + (((int64_t) 1) << (fracBits-1))) >> fracBits);
+}
+
+inline bool CurveGen::next(long &x, long &y) {
+    // Should be called from the step timer interrupt. Returns the next point
+    // on the curve and false once the end point has been returned.
+    if (_mode == modeNone) {
+        return false;
+    }
+    if (_count >= _numPts) {
+        if (_count > _numPts) {
+            _mode = modeNone;
+            return false;
+        }
+        _count++;
+        x = _xEnd;
+        y = _yEnd;
+        return true;
+    }
+    if (_mode == modeArc) {
+        // Minsky circle - rotates by 2^-shift radians per point
+        if (_ccw) {
+            _x -= _y >> _shift;
+            _y += _x >> _shift;
+        }
+        else {
+            _x += _y >> _shift;
+            _y -= _x >> _shift;
+        }
+    }
+    else {
+        _x += _dx1;
+        _dx1 += _dx2;
+        _dx2 += _dx3;
+        _y += _dy1;
+        _dy1 += _dy2;
+        _dy2 += _dy3;
+    }
+    _count++;
+    x = _xOrigin + roundFixed(_x);
+    y = _yOrigin + roundFixed(_y);
+    return true;
+}
+
+#endif
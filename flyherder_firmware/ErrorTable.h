@@ -0,0 +1,64 @@
+// ErrorTable.h
+#ifndef _ERROR_TABLE_H_
+#define _ERROR_TABLE_H_
+
+// The errors reported in command replies. Each entry is
+//
+//     ERR(Name, "message")
+//
+// which gives the error code errName. Only the code is kept when an error
+// occurs, e.g. SystemState::errCode; the message is in flash and is looked
+// up when the reply is sent. An error reply has both, as errCode and errMsg.
+#define ERROR_TABLE(ERR) \
+    ERR(None,                   "") \
+    \
+    ERR(UnknownCommand,         "unknown command") \
+    ERR(NumberOfArgs,           "incorrect number of arguments") \
+    ERR(ArgNotNumber,           "argument is not a number") \
+    ERR(ArgOutOfRange,          "argument out of range") \
+    ERR(ArgEmpty,               "argument is empty") \
+    ERR(AxisNameNotFound,       "axis name not found") \
+    ERR(AxisOutOfRange,         "axis argument out of range") \
+    ERR(HerderOutOfRange,       "herder argument out of range") \
+    \
+    ERR(DriveFault,             "drive fault, use clearFault") \
+    ERR(DriveFaultActive,       "drive fault input still active") \
+    ERR(EmergencyStop,          "emergency stop not yet reported") \
+    ERR(HerderRunning,          "herder is running") \
+    ERR(PositionNegative,       "position is less than 0") \
+    ERR(PositionSeparation,     "position is greater than max separation") \
+    ERR(PositionCollision,      "position results in collision between axes") \
+    ERR(ArmRunning,             "arm not allowed while running") \
+    ERR(TriggerPin,             "pin is not a trigger input") \
+    ERR(TriggerEdge,            "trigger edge must be R, F or N") \
+    ERR(MoveTime,               "move time <= 0") \
+    ERR(TimedMoveRunning,       "timed move not allowed while running") \
+    ERR(ArcAngle,               "arc angle out of range") \
+    ERR(ArcRadius,              "arc radius too large") \
+    ERR(CurveControlPoints,     "curve control points too far apart") \
+    ERR(PathRunning,            "path and other moves cannot run together") \
+    ERR(PathBufferFull,         "path buffer full") \
+    ERR(ComparePin,             "pin is not a compare output") \
+    ERR(ComparePulseWidth,      "pulse width out of range") \
+    ERR(CompareTableSize,       "too many compare positions") \
+    ERR(CompareTableOrder,      "compare positions must be increasing") \
+    ERR(CompareInterval,        "compare interval < 0") \
+    ERR(CompareOutputNotSet,    "compare output not set") \
+    ERR(CompareTableNotLoaded,  "no compare table loaded") \
+    ERR(NoRestoredPosition,     "no restored position to accept") \
+    ERR(Separation,             "separation value <= 0") \
+    ERR(SpeedMin,               "speed <  min allowed value") \
+    ERR(SpeedMax,               "speed > max allowed value") \
+    ERR(Acceleration,           "acceleration <= 0") \
+    ERR(JunctionDeviation,      "junction deviation < 0") \
+    ERR(Orientation,            "uknown value for orientation") \
+    ERR(StepsPerMM,             "stepsPerMM <= 0")
+
+#define ERR_ENUM(Name, msg) err##Name,
+enum {
+    ERROR_TABLE(ERR_ENUM)
+    numErrs
+};
+#undef ERR_ENUM
+
+#endif
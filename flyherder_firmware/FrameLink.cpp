@@ -0,0 +1,225 @@
+#include <util/crc16.h>
+#if defined(ARDUINO) && ARDUINO >= 100
+#include "Arduino.h"
+#else
+#include "WProgram.h"
+#endif
+#include "FrameLink.h"
+
+// Characters of the sequence number and CRC fields
+enum {FRAME_SEQ_LEN=2, FRAME_CRC_LEN=4};
+
+FrameLink::FrameLink(Print &port) : _port(port) {
+    _rxLen = 0;
+    _rxActive = false;
+    _rxOverflow = false;
+    _rxSeq = 0;
+    _payloadLen = 0;
+    _txActive = false;
+    _txTrailerSent = false;
+    _txCrc = 0xffff;
+    _replayLen = 0;
+    _replayCrc = 0;
+    _replaySeq = 0;
+    _replayValid = false;
+    _nakCount = 0;
+    _replayCount = 0;
+}
+
+void FrameLink::startRx() {
+    // Called on the frame start character. Anything received before it is
+    // discarded.
+    _rxLen = 0;
+    _rxActive = true;
+    _rxOverflow = false;
+}
+
+void FrameLink::cancelRx() {
+    // Drops a partly received frame
+    _rxLen = 0;
+    _rxActive = false;
+    _rxOverflow = false;
+}
+
+bool FrameLink::isReceiving() {
+    return _rxActive;
+}
+
+bool FrameLink::rxByte(uint8_t c) {
+    // Adds a received byte to the frame. Returns true at the end of the line,
+    // when the frame is ready to be checked.
+    if ((c == '\n') || (c == '\r')) {
+        _rxActive = false;
+        return true;
+    }
+    if (_rxLen < FRAME_RX_BUF_SZ) {
+        _rxBuf[_rxLen++] = c;
+    }
+    else {
+        _rxOverflow = true;
+    }
+    return false;
+}
+
+bool FrameLink::checkRx() {
+    // Checks the length, CRC and sequence number of the received frame.
+    if (_rxOverflow || (_rxLen < FRAME_SEQ_LEN + FRAME_CRC_LEN + 3)) {
+        return false;
+    }
+    uint8_t crcPos = _rxLen - FRAME_CRC_LEN;
+    if (_rxBuf[crcPos-1] != FRAME_CRC_SEP) {
+        return false;
+    }
+    uint16_t seq;
+    uint16_t crcRx;
+    if (!readHex(_rxBuf, FRAME_SEQ_LEN, seq)) {
+        return false;
+    }
+    if (!readHex(&_rxBuf[crcPos], FRAME_CRC_LEN, crcRx)) {
+        return false;
+    }
+    uint16_t crc = 0xffff;
+    for (uint8_t i=0; i<crcPos-1; i++) {
+        crc = crcUpdate(crc, _rxBuf[i]);
+    }
+    if (crc != crcRx) {
+        return false;
+    }
+    _rxSeq = seq;
+    _payloadLen = crcPos - 1 - FRAME_SEQ_LEN;
+    return true;
+}
+
+const char *FrameLink::getPayload() {
+    return &_rxBuf[FRAME_SEQ_LEN];
+}
+
+uint8_t FrameLink::getPayloadLen() {
+    return _payloadLen;
+}
+
+bool FrameLink::isRepeat() {
+    // True if the checked frame repeats the last command replied to
+    return (_rxSeq != 0) && (_rxSeq == _replaySeq);
+}
+
+void FrameLink::startReply() {
+    // Starts the framed reply to the checked command. Framing ends with the
+    // end of the reply line.
+    _replaySeq = _rxSeq;
+    _replayLen = 0;
+    _replayValid = true;
+    _port.write(FRAME_START);
+    _txCrc = writeHex(_rxSeq, FRAME_SEQ_LEN, 0xffff);
+    _txTrailerSent = false;
+    _txActive = true;
+}
+
+bool FrameLink::replay() {
+    // Sends the last reply again. Returns false if it was too long to keep.
+    if (!_replayValid) {
+        return false;
+    }
+    _port.write(FRAME_START);
+    writeHex(_replaySeq, FRAME_SEQ_LEN, 0);
+    for (uint8_t i=0; i<_replayLen; i++) {
+        _port.write(_replayBuf[i]);
+    }
+    writeTrailer(_replayCrc);
+    _port.println();
+    if (_replayCount < 0xffff) {
+        _replayCount++;
+    }
+    return true;
+}
+
+void FrameLink::sendNak() {
+    _port.write(FRAME_START);
+    _port.write(FRAME_NAK);
+    _port.println();
+    if (_nakCount < 0xffff) {
+        _nakCount++;
+    }
+}
+
+uint16_t FrameLink::getNakCount() {
+    return _nakCount;
+}
+
+uint16_t FrameLink::getReplayCount() {
+    return _replayCount;
+}
+
+#if defined(ARDUINO) && ARDUINO >= 100
+size_t FrameLink::write(uint8_t c) {
+#else
+void FrameLink::write(uint8_t c) {
+#endif
+    if (_txActive) {
+        if ((c == '\r') || (c == '\n')) {
+            if (!_txTrailerSent) {
+                writeTrailer(_txCrc);
+                _replayCrc = _txCrc;
+                _txTrailerSent = true;
+            }
+            _txActive = (c != '\n');
+        }
+        else {
+            _txCrc = crcUpdate(_txCrc, c);
+            if (_replayLen < FRAME_REPLAY_BUF_SZ) {
+                _replayBuf[_replayLen++] = c;
+            }
+            else {
+                _replayValid = false;
+            }
+        }
+    }
+    _port.write(c);
+#if defined(ARDUINO) && ARDUINO >= 100
+    return 1;
+#endif
+}
+
+uint16_t FrameLink::crcUpdate(uint16_t crc, uint8_t c) {
+    // CRC-16, polynomial 0x1021, most significant bit first
+    return _crc_xmodem_update(crc, c);
+}
+
+uint16_t FrameLink::writeHex(uint16_t value, uint8_t digits, uint16_t crc) {
+    // Writes value in upper case hex and returns crc updated with the digits
+    while (digits > 0) {
+        digits--;
+        uint8_t nibble = (value >> (4*digits)) & 0xf;
+        char c = (nibble < 10) ? '0' + nibble : 'A' + nibble - 10;
+        _port.write(c);
+        crc = crcUpdate(crc, c);
+    }
+    return crc;
+}
+
+bool FrameLink::readHex(const char *str, uint8_t digits, uint16_t &value) {
+    value = 0;
+    for (uint8_t i=0; i<digits; i++) {
+        char c = str[i];
+        uint8_t nibble;
+        if ((c >= '0') && (c <= '9')) {
+            nibble = c - '0';
+        }
+        else if ((c >= 'A') && (c <= 'F')) {
+            nibble = c - 'A' + 10;
+        }
+        else if ((c >= 'a') && (c <= 'f')) {
+            nibble = c - 'a' + 10;
+        }
+        else {
+            return false;
+        }
+        value = (value << 4) | nibble;
+    }
+    return true;
+}
+
+void FrameLink::writeTrailer(uint16_t crc) {
+    _port.write(FRAME_CRC_SEP);
+    writeHex(crc, FRAME_CRC_LEN, 0);
+}
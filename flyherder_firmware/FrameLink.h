@@ -0,0 +1,101 @@
+// FrameLink.h
+#ifndef _FRAME_LINK_H_
+#define _FRAME_LINK_H_
+
+#include <stdint.h>
+#if defined(ARDUINO) && ARDUINO >= 100
+#include "Arduino.h"
+#else
+#include "WProgram.h"
+#endif
+
+enum {
+    FRAME_RX_BUF_SZ=128,
+    FRAME_REPLAY_BUF_SZ=160,
+};
+
+enum {
+    FRAME_START='#',
+    FRAME_CRC_SEP='*',
+    FRAME_NAK='!',
+};
+
+// Optional integrity framing of commands and replies. A framed command is
+//
+//   #SS[cmdId,arg,...]*CCCC\n
+//
+// where SS is a sequence number and CCCC the CRC-16 (CCITT, initial value
+// 0xffff) of everything between the '#' and the '*', both in upper case hex.
+// The reply is framed the same way, #SS{...}*CCCC, with the command's
+// sequence number. A command that fails the check, or is malformed, is
+// answered with the line #! and should be sent again. Unframed commands are
+// handled as before, so framing is chosen by the host command by command.
+//
+// The last framed reply is kept, and a command repeating the previous
+// sequence number - sent again because its reply was lost or corrupted - is
+// answered from it without being run a second time. Sequence number 0 is
+// never treated as a repeat, so a host can start from it after connecting.
+// A reply too long to keep is not replayed and the command is run again;
+// only long query replies, e.g. getCmds, are that size.
+//
+// Prints to the serial port: while a reply is being framed, everything
+// written up to the end of the line goes into the CRC and replay buffer.
+class FrameLink : public Print {
+
+    public:
+        FrameLink(Print &port);
+
+        void startRx();
+        void cancelRx();
+        bool isReceiving();
+        bool rxByte(uint8_t c);
+        bool checkRx();
+        const char *getPayload();
+        uint8_t getPayloadLen();
+        bool isRepeat();
+
+        void startReply();
+        bool replay();
+        void sendNak();
+
+        uint16_t getNakCount();
+        uint16_t getReplayCount();
+
+#if defined(ARDUINO) && ARDUINO >= 100
+        size_t write(uint8_t c);
+#else
+        void write(uint8_t c);
+#endif
+        using Print::write;
+
+        static uint16_t crcUpdate(uint16_t crc, uint8_t c);
+
+    private:
+        Print &_port;
+
+        char _rxBuf[FRAME_RX_BUF_SZ];
+        uint8_t _rxLen;
+        bool _rxActive;
+        bool _rxOverflow;
+        uint8_t _rxSeq;
+        uint8_t _payloadLen;
+
+        bool _txActive;
+        bool _txTrailerSent;
+        uint16_t _txCrc;
+
+        char _replayBuf[FRAME_REPLAY_BUF_SZ];
+        uint8_t _replayLen;
+        uint16_t _replayCrc;
+        uint8_t _replaySeq;
+        bool _replayValid;
+
+        uint16_t _nakCount;
+        uint16_t _replayCount;
+
+        uint16_t writeHex(uint16_t value, uint8_t digits, uint16_t crc);
+        bool readHex(const char *str, uint8_t digits, uint16_t &value);
+        void writeTrailer(uint16_t crc);
+};
+
+#endif
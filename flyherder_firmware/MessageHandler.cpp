@@ -3,420 +3,341 @@
 #include "Streaming.h"
 #include "SystemState.h"
 #include "Array.h"
+#include "SerialPort.h"
 
+#define CMD_ENUM(Name, name, args) cmd##Name,
 enum {
-    cmdGetDevInfo,             // Done
-    cmdGetCmds,                // Done
-    cmdGetRspCodes,            // Done
-
-    cmdGetNumAxis,             // Done
-    cmdGetNumDim,              // Done
-    cmdGetAxisNames,           // Done  
-    cmdGetDimNames,            // Done
-    cmdGetAxisOrder,           // Done
-    cmdGetDimOrder,            // Done
-    cmdGetAllowedOrientation,  // Done
-
-    cmdSetDrivePowerOn,        // Done  
-    cmdSetDrivePowerOff,       // Done 
-    cmdIsDrivePowerOn,         // Done
-    
-    cmdStop,                   // Done  
-    cmdIsRunning,              // Done  
-
-#ifdef HAVE_ENABLE
-    cmdEnable,                 // Done 
-    cmdDisable,                // Done  
-    cmdIsEnabled,              // Done 
-#endif
-
-    cmdMoveToPosition,         // Done  
-    cmdMoveAxisToPosition,     // Done 
-    cmdMoveToHome,             // Done  
-    cmdMoveAxisToHome,         // 
-    cmdIsInHomePosition,       // Done 
-
-    cmdGetPosition,            // Done 
-    cmdGetAxisPosition,        // Done 
-    cmdSetPosition,            //
-    cmdSetAxisPosition,        //
-
-    cmdSetMaxSeparation,       // Done
-    cmdGetMaxSeparation,       // Done
-    
-    cmdSetSpeed,               // Done 
-    cmdGetSpeed,               // Done 
-
-    cmdSetOrientation,         // Done 
-    cmdGetOrientation,         // Done 
-
-    cmdSetAxisOrientation,     // Done 
-    cmdGetAxisOrientation,     // Done
-
-    cmdSetStepsPerMM,          // Done
-    cmdGetStepsPerMM,          // Done
-
-    cmdEnableBoundsCheck,      // Done
-    cmdDisableBoundsCheck,     // Done
-    cmdIsBoundsCheckEnabled,   // Done
+    COMMAND_TABLE(CMD_ENUM)
+    numCmds
+};
+#undef CMD_ENUM
 
-    cmdSetSerialNumber,        //
-    cmdGetSerialNumber,        // Done 
+#define CMD_STRINGS(Name, name, args) \
+    const char cmdName##Name[] PROGMEM = name; \
+    const char cmdArgs##Name[] PROGMEM = args;
+COMMAND_TABLE(CMD_STRINGS)
+#undef CMD_STRINGS
 
-    cmdGetModelNumber,         // Done 
+#define ERR_STRING(Name, msg) const char errMsg##Name[] PROGMEM = msg;
+ERROR_TABLE(ERR_STRING)
+#undef ERR_STRING
 
-    // DEVELOPMENT
-    cmdDebug, 
+#define ERR_MSG(Name, msg) errMsg##Name,
+const char * const errMsgTable[] PROGMEM = {
+    ERROR_TABLE(ERR_MSG)
 };
+#undef ERR_MSG
 
+#define CMD_INFO(Name, name, args) {cmdName##Name, cmdArgs##Name, &MessageHandler::handle##Name},
+const MessageHandler::CommandInfo MessageHandler::commandTable[] PROGMEM = {
+    COMMAND_TABLE(CMD_INFO)
+};
+#undef CMD_INFO
 
 const int rspSuccess = 1;
 const int rspError = 0;
 
+MessageHandler::MessageHandler() : framer(serialPort), dprint(framer) {
+    framedReply = false;
+    axisHashPerfect = true;
+    for (int i=0; i<AXIS_HASH_SZ; i++) {
+        axisHashTable[i] = -1;
+    }
+    for (int i=0; i<constants::numAxis; i++) {
+        uint8_t slot = nameHash(constants::axisNames[i]) & (AXIS_HASH_SZ-1);
+        if (axisHashTable[slot] >= 0) {
+            axisHashPerfect = false;
+        }
+        axisHashTable[slot] = i;
+    }
+}
+
 void MessageHandler::processMsg() {
-    while (Serial.available() > 0) {
-        process(Serial.read());
-        if (messageReady()) {
-            msgSwitchYard();
+    systemState.updatePositionStore();
+    if (systemState.checkEmergencyStop()) {
+        sendEvent(F("emergencyStop"));
+    }
+    if (systemState.checkDriveFaultEvent()) {
+        sendEvent(F("driveFault"));
+    }
+    if (systemState.checkDriveReadyEvent()) {
+        sendEvent(F("driveReady"));
+    }
+    while (serialPort.available() > 0) {
+        if (serialPort.checkRxFlushed()) {
+            // An emergency stop discarded the rest of the message being
+            // received.
             reset();
-        }   
+            framer.cancelRx();
+        }
+        int c = serialPort.read();
+        if (c < 0) {
+            break;
+        }
+        if (c == FRAME_START) {
+            framer.startRx();
+        }
+        else if (framer.isReceiving()) {
+            if (framer.rxByte(c)) {
+                processFrame();
+            }
+        }
+        else {
+            process(c);
+            if (messageReady()) {
+                msgSwitchYard();
+                reset();
+            }   
+        }
     }   
     return;
 }
 
+void MessageHandler::processFrame() {
+    // A framed command is checked and unwrapped here and then handled the
+    // same way as an unframed one, with its reply framed. See FrameLink.h.
+    reset();
+    if (!framer.checkRx()) {
+        framer.sendNak();
+        return;
+    }
+    if (framer.isRepeat() && framer.replay()) {
+        return;
+    }
+    const char *payload = framer.getPayload();
+    for (uint8_t i=0; i<framer.getPayloadLen(); i++) {
+        process(payload[i]);
+    }
+    if (!messageReady()) {
+        reset();
+        framer.sendNak();
+        return;
+    }
+    framedReply = true;
+    msgSwitchYard();
+    framedReply = false;
+    reset();
+}
+
 void MessageHandler::msgSwitchYard() {
     int cmd = readInt(0); 
-    dprint.start();
-    dprint.addIntItem("cmdId", cmd);
-
-    switch (cmd) { 
-
-        case cmdGetDevInfo:
-            handleGetDevInfo();
-            break;
-
-        case cmdGetCmds:
-            handleGetCmds();
-            break;
-
-        case cmdGetRspCodes:
-            handleGetRspCodes();
-            break;
-
-        case cmdGetNumAxis:
-            handleGetNumAxis();
-            break;
-
-        case cmdGetNumDim:
-            handleGetNumDim();
-            break;
-
-        case cmdGetAxisNames:
-            handleGetAxisNames();
-            break;
-
-        case cmdGetDimNames:
-            handleGetDimNames();
-            break;
-
-        case cmdGetAxisOrder:
-            handleGetAxisOrder();
-            break;
-
-        case cmdGetDimOrder:
-            handleGetDimOrder();
-            break;
-
-        case cmdGetAllowedOrientation:
-            handleGetAllowedOrientation();
-            break;
-
-        case cmdSetDrivePowerOn:
-            handleSetDrivePowerOn();
-            break;
-
-        case cmdSetDrivePowerOff:
-            handleSetDrivePowerOff();
-            break;
-
-        case cmdIsDrivePowerOn:
-            handleIsDrivePowerOn();
-            break;
-
-        case cmdStop: 
-            handleStop();
-            break;
 
-        case cmdIsRunning:
-            handleIsRunning();
-            break;
-
-#ifdef HAVE_ENABLE
-        case cmdEnable:
-            handleEnable();
-            break;
-
-        case cmdDisable:
-            handleDisable();
-            break;
-
-        case cmdIsEnabled:
-            handleIsEnabled();
-            break;
-#endif
-
-        case cmdMoveToPosition:
-            handleMoveToPosition();
-            break;
-
-        case cmdMoveAxisToPosition:
-            handleMoveAxisToPosition();
-            break;
-
-        case cmdMoveToHome:
-            handleMoveToHome();
-            break;
-
-        case cmdMoveAxisToHome:
-            handleMoveAxisToHome();
-            break;
-
-        case cmdGetPosition:
-            handleGetPosition();
-            break;
-
-        case cmdGetAxisPosition:
-            handleGetAxisPosition();
-            break;
-
-        case cmdSetPosition:
-            handleSetPosition();
-            break;
-
-        case cmdSetAxisPosition:
-            handleSetAxisPosition();
-            break;
-
-        case cmdSetMaxSeparation:
-            handleSetMaxSeparation();
-            break;
-
-        case cmdGetMaxSeparation:
-            handleGetMaxSeparation();
-            break;
-
-        case cmdSetSpeed:
-            handleSetSpeed();
-            break;
-
-        case cmdGetSpeed:
-            handleGetSpeed();
-            break;
-
-        case cmdIsInHomePosition:
-            handleIsInHomePosition();
-            break;
-
-        case cmdSetOrientation:
-            handleSetOrientation();
-            break;
-
-        case cmdGetOrientation:
-            handleGetOrientation();
-            break;
-
-        case cmdSetAxisOrientation:
-            handleSetAxisOrientation();
-            break;
-
-        case cmdGetAxisOrientation:
-            handleGetAxisOrientation();
-            break;
-
-        case cmdSetStepsPerMM:
-            handleSetStepsPerMM();
-            break;
-
-        case cmdGetStepsPerMM:
-            handleGetStepsPerMM();
-            break;
-
-        case cmdEnableBoundsCheck: 
-            handleEnableBoundsCheck();
-            break;
-
-        case cmdDisableBoundsCheck: 
-            handleDisableBoundsCheck();
-            break;
-
-        case cmdIsBoundsCheckEnabled: 
-            handleIsBoundsCheckEnabled();
-            break;
+    // The stop reply goes ahead of any bulk output still being sent.
+    bool priority = (cmd == cmdStop);
+    if (priority) {
+        serialPort.startPriority();
+    }
+    if (framedReply) {
+        framer.startReply();
+    }
+    dprint.start();
+    dprint.addIntItem(F("cmdId"), cmd);
 
-        case cmdSetSerialNumber:
-            handleSetSerialNumber();
-            break;
+    if ((cmd >= 0) && (cmd < numCmds)) {
+        CommandInfo info;
+        readCommandInfo(cmd,info);
+        if (checkArgs(info.args)) {
+            (this->*info.handler)();
+        }
+    }
+    else {
+        errorRsp(errUnknownCommand);
+    }
+    dprint.stop();
+    if (priority) {
+        serialPort.endPriority();
+    }
+}
 
-        case cmdGetSerialNumber:
-            handleGetSerialNumber();
-            break;
+void MessageHandler::sendReady() {
+    // Ready banner, sent once at the end of setup so that the host can wait
+    // for it rather than for a fixed time after the reset.
+    dprint.start();
+    dprint.addStrItem(F("event"), F("ready"));
+    dprint.addIntItem(F("modelNumber"), constants::deviceModelNumber);
+    dprint.addIntItem(F("serialNumber"), constants::deviceSerialNumber);
+    dprint.addStrItem(F("firmware"), (const __FlashStringHelper *) constants::firmwareId);
+    dprint.addIntItem(F("restored"), systemState.isPositionRestored());
+    dprint.addIntItem(F("stale"), systemState.isStoredPositionStale());
+    dprint.stop();
+}
 
-        case cmdGetModelNumber:
-            handleGetModelNumber();
-            break;
+void MessageHandler::sendEvent(const __FlashStringHelper *name) {
+    // Events are not replies to a command and have no cmdId. They are sent
+    // on the priority lane.
+    serialPort.startPriority();
+    dprint.start();
+    dprint.addStrItem(F("event"), name);
+    dprint.stop();
+    serialPort.endPriority();
+}
 
-        // DEVELOPMENT
-        case cmdDebug:
-            handleDebug();
-            break;
+void MessageHandler::readCommandInfo(int cmd, CommandInfo &info) {
+    memcpy_P(&info, &commandTable[cmd], sizeof(CommandInfo));
+}
 
-        default:
-            dprint.addIntItem("status", rspError);
-            dprint.addStrItem("errMsg", "unknown command");
-           break;
-    }              
-    dprint.stop();
+bool MessageHandler::checkArgs(const char *args) {
+    // Checks the arguments against the command's args string, in flash. 
+    // See CommandTable.h.
+    int numArgs = strlen_P(args);
+    bool repeat = (numArgs > 0) && (pgm_read_byte(args + numArgs - 1) == '*');
+    int num = numberOfItems() - 1;
+    if (repeat) {
+        numArgs--;
+    }
+    if (repeat ? (num < numArgs - 1) : (num != numArgs)) {
+        errorRsp(errNumberOfArgs);
+        return false;
+    }
+    for (int i=0; i<num; i++) {
+        char type = pgm_read_byte(args + ((i < numArgs) ? i : numArgs-1));
+        if (!checkArg(i+1,type)) {
+            return false;
+        }
+    }
+    return true;
 }
 
-bool MessageHandler::checkNumberOfArgs(int num) {
-    bool flag = true;
-    if (numberOfItems() != num) {
-        dprint.addIntItem("status", rspError);
-        dprint.addStrItem("errMsg", "incorrect number of arguments");
-        flag = false;
+bool MessageHandler::checkArg(int item, char type) {
+    int axisNumber;
+    switch (type) {
+        case 'f':
+            if (!isNumber(item)) {
+                errorRsp(errArgNotNumber);
+                return false;
+            }
+            break;
+
+        case 'i':
+            if (!isNumber(item)) {
+                errorRsp(errArgNotNumber);
+                return false;
+            }
+            if (!isLong(item)) {
+                errorRsp(errArgOutOfRange);
+                return false;
+            }
+            break;
+
+        case 'a':
+            return getAxisNumberFromArg(item,axisNumber);
+
+        case 'c':
+            if (itemLength(item) == 0) {
+                errorRsp(errArgEmpty);
+                return false;
+            }
+            break;
     }
-    return flag;
+    return true;
 }
 
 bool MessageHandler::checkAxisArg(int axis) {
     bool flag = true;
     if ((axis<0) || (axis>constants::numAxis)) {
-        dprint.addIntItem("status", rspError);
-        dprint.addStrItem("errMsg", "axis argument out of range");
+        errorRsp(errAxisOutOfRange);
         flag = false;
     }
     return flag;
 }
 
-bool MessageHandler::getAxisNumberFromName(char *name, int &number) {
-    bool found = false;
-    for (int i=0; i<constants::numAxis; i++) {
-        if (strcmp(name, constants::axisNames[i]) == 0) {
+bool MessageHandler::getAxisNumberFromArg(int item, int &number) {
+    // The axis name is looked up by its hash and confirmed with a single 
+    // compare. The names are searched in turn only if their hashes collide.
+    if (axisHashPerfect) {
+        int i = axisHashTable[itemHash(item) & (AXIS_HASH_SZ-1)];
+        if ((i >= 0) && itemEquals(item, constants::axisNames[i])) {
             number = i;
             return true;
         }
-    } 
-    dprint.addIntItem("status", rspError);
-    dprint.addStrItem("errMsg", "axis name not found");
+    }
+    else {
+        for (int i=0; i<constants::numAxis; i++) {
+            if (itemEquals(item, constants::axisNames[i])) {
+                number = i;
+                return true;
+            }
+        }
+    }
+    errorRsp(errAxisNameNotFound);
     return false;
 }
 
 void MessageHandler::systemCmdRsp(bool flag) {
     if (flag) {
-        dprint.addIntItem("status", rspSuccess);
+        dprint.addIntItem(F("status"), rspSuccess);
     }
     else {
-        dprint.addIntItem("status", rspError);
-        dprint.addStrItem("errMsg", systemState.errMsg); 
+        errorRsp(systemState.errCode);
     }
 } 
 
+void MessageHandler::errorRsp(uint8_t code) {
+    const char *msg;
+    if (code >= numErrs) {
+        code = errNone;
+    }
+    memcpy_P(&msg, &errMsgTable[code], sizeof(msg));
+    dprint.addIntItem(F("status"), rspError);
+    dprint.addIntItem(F("errCode"), code);
+    dprint.addStrItem(F("errMsg"), (const __FlashStringHelper *) msg);
+}
+
 void MessageHandler::handleGetDevInfo() {
-    dprint.addIntItem("status", rspSuccess);
-    dprint.addIntItem("ModelNumber",  constants::deviceModelNumber);
-    dprint.addIntItem("SerialNumber", constants::deviceSerialNumber); 
+    dprint.addIntItem(F("status"), rspSuccess);
+    dprint.addIntItem(F("ModelNumber"),  constants::deviceModelNumber);
+    dprint.addIntItem(F("SerialNumber"), constants::deviceSerialNumber); 
+    dprint.addStrItem(F("Firmware"), (const __FlashStringHelper *) constants::firmwareId);
 }
 
 void MessageHandler::handleGetCmds() {
-    dprint.addIntItem("status", rspSuccess);
-    dprint.addIntItem("getDevInfo", cmdGetDevInfo);
-    dprint.addIntItem("getCmds", cmdGetCmds);        
-    dprint.addIntItem("getRspCodes", cmdGetRspCodes);
-    dprint.addIntItem("getNumAxis", cmdGetNumAxis);
-    dprint.addIntItem("getNumDim", cmdGetNumDim);
-    dprint.addIntItem("getAxisNames", cmdGetAxisNames);
-    dprint.addIntItem("getDimNames", cmdGetDimNames);
-    dprint.addIntItem("getAxisOrder", cmdGetAxisOrder);
-    dprint.addIntItem("getDimOrder", cmdGetDimOrder);
-    dprint.addIntItem("getAllowedOrientation", cmdGetAllowedOrientation);
-    dprint.addIntItem("setDrivePowerOn", cmdSetDrivePowerOn);
-    dprint.addIntItem("setDrivePowerOff", cmdSetDrivePowerOff);
-    dprint.addIntItem("isDrivePowerOn", cmdIsDrivePowerOn);
-    dprint.addIntItem("stop", cmdStop);             
-    dprint.addIntItem("isRunning", cmdIsRunning);        
-#ifdef HAVE_ENABLE
-    dprint.addIntItem("enable", cmdEnable);          
-    dprint.addIntItem("disable", cmdDisable);          
-    dprint.addIntItem("isEnabled", cmdIsEnabled);        
-#endif
-    dprint.addIntItem("moveToPosition", cmdMoveToPosition);        
-    dprint.addIntItem("moveAxisToPosition", cmdMoveAxisToPosition);
-    dprint.addIntItem("moveToHome", cmdMoveToHome);     
-    dprint.addIntItem("moveAxisToHome", cmdMoveAxisToHome);
-    dprint.addIntItem("isInHomePosition", cmdIsInHomePosition);   
-    dprint.addIntItem("setMaxSeparation", cmdSetMaxSeparation);
-    dprint.addIntItem("getMaxSeparation", cmdGetMaxSeparation);
-    dprint.addIntItem("getPosition", cmdGetPosition);
-    dprint.addIntItem("getAxisPosition", cmdGetAxisPosition);
-    dprint.addIntItem("setPosition", cmdSetPosition);
-    dprint.addIntItem("setAxisPosition", cmdSetAxisPosition);
-    dprint.addIntItem("setSpeed", cmdSetSpeed);      
-    dprint.addIntItem("getSpeed", cmdGetSpeed);      
-    dprint.addIntItem("setOrientation", cmdSetOrientation);
-    dprint.addIntItem("getOrientation", cmdGetOrientation);
-    dprint.addIntItem("setAxisOrientation", cmdSetAxisOrientation);
-    dprint.addIntItem("getAxisOrientation", cmdGetAxisOrientation);
-    dprint.addIntItem("setStepsPerMM", cmdSetStepsPerMM);
-    dprint.addIntItem("getStepsPerMM", cmdGetStepsPerMM);
-    dprint.addIntItem("enableBoundsCheck", cmdEnableBoundsCheck);
-    dprint.addIntItem("disableBoundsCheck", cmdDisableBoundsCheck);
-    dprint.addIntItem("isBoundsCheckEnabled", cmdIsBoundsCheckEnabled);
-    dprint.addIntItem("setSerialNumber", cmdSetSerialNumber);
-    dprint.addIntItem("getSerialNumber", cmdGetSerialNumber);
-    dprint.addIntItem("getModelNumber", cmdGetModelNumber);
-    // DEVELOPMENT
-    dprint.addIntItem("cmdDebug", cmdDebug);
+    CommandInfo info;
+    dprint.addIntItem(F("status"), rspSuccess);
+    for (int i=0; i<numCmds; i++) {
+        readCommandInfo(i,info);
+        dprint.addIntItem((const __FlashStringHelper *) info.name, i);
+    }
 } 
 
 void MessageHandler::handleGetRspCodes() {
-    dprint.addIntItem("status", rspSuccess);
-    dprint.addIntItem("rspSuccess",rspSuccess);
-    dprint.addIntItem("rspError", rspError);
+    dprint.addIntItem(F("status"), rspSuccess);
+    dprint.addIntItem(F("rspSuccess"),rspSuccess);
+    dprint.addIntItem(F("rspError"), rspError);
 }
 
 void MessageHandler::handleGetNumAxis() {
-    dprint.addIntItem("status", rspSuccess);
-    dprint.addIntItem("numAxis", constants::numAxis);
+    dprint.addIntItem(F("status"), rspSuccess);
+    dprint.addIntItem(F("numAxis"), constants::numAxis);
 }
 
 void MessageHandler::handleGetNumDim() {
-    dprint.addIntItem("status", rspSuccess);
-    dprint.addIntItem("numDim", constants::numDim);
+    dprint.addIntItem(F("status"), rspSuccess);
+    dprint.addIntItem(F("numDim"), constants::numDim);
 }
 
 void MessageHandler::handleGetAxisNames() {
-    dprint.addIntItem("status", rspSuccess);
+    dprint.addIntItem(F("status"), rspSuccess);
     for (int i=0; i<constants::numAxis; i++) {
         dprint.addEmptyItem((char*) constants::axisNames[i]);
     }
 }
 
 void MessageHandler::handleGetDimNames() {
-    dprint.addIntItem("status", rspSuccess);
+    dprint.addIntItem(F("status"), rspSuccess);
     for (int i=0; i<constants::numDim; i++) {
         dprint.addEmptyItem((char*) constants::dimNames[i]);
     }
 }
 
 void MessageHandler::handleGetAxisOrder() {
-    dprint.addIntItem("status", rspSuccess);
+    dprint.addIntItem(F("status"), rspSuccess);
     for (int i=0; i<constants::numAxis; i++) {
         dprint.addIntItem((char*) constants::axisNames[i], i);
     }
 }
 
 void MessageHandler::handleGetDimOrder() {
-    dprint.addIntItem("status", rspSuccess);
+    dprint.addIntItem(F("status"), rspSuccess);
     for (int i=0; i<constants::numDim; i++) {
         dprint.addIntItem((char*) constants::dimNames[i], i);
     }
@@ -424,113 +345,321 @@ void MessageHandler::handleGetDimOrder() {
 
 void MessageHandler::handleGetAllowedOrientation() {
     char orientationStr[2];
-    dprint.addIntItem("status", rspSuccess);
+    dprint.addIntItem(F("status"), rspSuccess);
     for (int i=0; i<constants::numOrientation; i++) {
-        snprintf(orientationStr,2,"%c",constants::allowedOrientation[i]);
+        orientationStr[0] = constants::allowedOrientation[i];
+        orientationStr[1] = '\0';
         dprint.addEmptyItem(orientationStr);
     }
 }
 
 void MessageHandler::handleSetDrivePowerOn() {
-    dprint.addIntItem("status", rspSuccess);
+    dprint.addIntItem(F("status"), rspSuccess);
     systemState.setDrivePowerOn();
 }
 
 void MessageHandler::handleSetDrivePowerOff() {
-    dprint.addIntItem("status", rspSuccess);
+    dprint.addIntItem(F("status"), rspSuccess);
     systemState.setDrivePowerOff();
 }
 
 void MessageHandler::handleIsDrivePowerOn() {
-    dprint.addIntItem("status", rspSuccess);
-    dprint.addIntItem("isDrivePowerOn", systemState.isDrivePowerOn());
+    dprint.addIntItem(F("status"), rspSuccess);
+    dprint.addIntItem(F("isDrivePowerOn"), systemState.isDrivePowerOn());
+}
+
+void MessageHandler::handleIsDriveReady() {
+    dprint.addIntItem(F("status"), rspSuccess);
+    dprint.addIntItem(F("isDriveReady"), systemState.isDriveReady());
+}
+
+void MessageHandler::handleGetFaultStatus() {
+    // Latched fault state, the state of the fault input and the time (ms),
+    // running axes (bit mask) and axis positions at the time of the fault.
+    Array<float,constants::numAxis> position;
+    systemState.getDriveFaultPosition(position);
+    dprint.addIntItem(F("status"), rspSuccess);
+    dprint.addIntItem(F("fault"), systemState.isDriveFault());
+    dprint.addIntItem(F("faultInput"), systemState.isDriveFaultInputActive());
+    dprint.addLongItem(F("faultTime"), (long) systemState.getDriveFaultTime());
+    dprint.addIntItem(F("faultAxisMask"), systemState.getDriveFaultAxisMask());
+    for (int i=0; i<constants::numAxis; i++) {
+        dprint.addFltItem((char*)constants::axisNames[i],position[i]);
+    }
+}
+
+void MessageHandler::handleClearFault() {
+    bool flag = systemState.clearDriveFault();
+    systemCmdRsp(flag);
 }
 
 void MessageHandler::handleStop() { 
     systemState.stop();
-    dprint.addIntItem("status",rspSuccess);
+    dprint.addIntItem(F("status"),rspSuccess);
 }
 
 void MessageHandler::handleIsRunning() {
-    dprint.addIntItem("status",rspSuccess);
-    dprint.addIntItem("isRunning", systemState.isRunning());
+    dprint.addIntItem(F("status"),rspSuccess);
+    dprint.addIntItem(F("isRunning"), systemState.isRunning());
 }
 
 
 #ifdef HAVE_ENABLE
 void MessageHandler::handleEnable() {
     systemState.enable();
-    dprint.addIntItem("status",rspSuccess);
+    dprint.addIntItem(F("status"),rspSuccess);
 }
 
 void MessageHandler::handleDisable() {
     systemState.disable();
-    dprint.addIntItem("status",rspSuccess);
+    dprint.addIntItem(F("status"),rspSuccess);
 }
 
 void MessageHandler::handleIsEnabled() {
-    dprint.addIntItem("status", rspSuccess);
-    dprint.addIntItem("isEnabled", systemState.isEnabled());
+    dprint.addIntItem(F("status"), rspSuccess);
+    dprint.addIntItem(F("isEnabled"), systemState.isEnabled());
 }
 #endif
 
 void MessageHandler::handleMoveToPosition() {
     Array<float,constants::numAxis> pos;
-    if (!checkNumberOfArgs(constants::numAxis+1)) {return;}
     for (int i=0; i<constants::numAxis; i++) {
         pos[i] = readFloat(i+1);
     }
     systemCmdRsp(systemState.moveToPosition(pos));
 }
 
+void MessageHandler::handleArmMove() {
+    // Same arguments as moveToPosition. The move starts on the fast path 
+    // startArmedByte.
+    Array<float,constants::numAxis> pos;
+    for (int i=0; i<constants::numAxis; i++) {
+        pos[i] = readFloat(i+1);
+    }
+    systemCmdRsp(systemState.armMove(pos));
+}
+
+void MessageHandler::handleIsArmed() {
+    dprint.addIntItem(F("status"), rspSuccess);
+    dprint.addIntItem(F("isArmed"), systemState.isArmed());
+}
+
+void MessageHandler::handleCancelArmed() {
+    systemState.cancelArmed();
+    dprint.addIntItem(F("status"), rspSuccess);
+}
+
+void MessageHandler::handleSetTrigger() {
+    int pin;
+    char edge;
+    pin = readInt(1);
+    edge = readChar(2,0);
+    systemCmdRsp(systemState.setTrigger(pin,edge));
+}
+
+void MessageHandler::handleGetTrigger() {
+    // Trigger input pin and edge, and the time (us) the last trigger 
+    // interrupt took from its entry to the first step (-1 if none).
+    dprint.addIntItem(F("status"), rspSuccess);
+    dprint.addIntItem(F("pin"), systemState.getTriggerPin());
+    dprint.addCharItem(F("edge"), systemState.getTriggerEdge());
+    dprint.addLongItem(F("isrTime"), systemState.getTriggerIsrTime());
+}
+
 void MessageHandler::handleMoveAxisToPosition() {
-    char axisName[constants::nameSize];
     int axisNumber;
     float pos;
-    if (!checkNumberOfArgs(3)) {return;}
-    copyString(1,axisName,constants::nameSize);
     pos = readFloat(2);
-    if (!getAxisNumberFromName(axisName,axisNumber)) {return;}
+    if (!getAxisNumberFromArg(1,axisNumber)) {return;}
     systemCmdRsp(systemState.moveAxisToPosition(axisNumber,pos));
 }
 
+void MessageHandler::handleMoveToPositionInTime() {
+    Array<float,constants::numAxis> pos;
+    float t;
+    for (int i=0; i<constants::numAxis; i++) {
+        pos[i] = readFloat(i+1);
+    }
+    t = readFloat(constants::numAxis+1);
+    systemCmdRsp(systemState.moveToPositionInTime(pos,t));
+}
+
+void MessageHandler::handleMoveArc() {
+    int herder;
+    float xc;
+    float yc;
+    float angle;
+    herder = readInt(1);
+    xc = readFloat(2);
+    yc = readFloat(3);
+    angle = readFloat(4);
+    systemCmdRsp(systemState.moveArc(herder,xc,yc,angle));
+}
+
+void MessageHandler::handleMoveBezier() {
+    Array<float,3*constants::numDim> ctrlPts;
+    int herder;
+    herder = readInt(1);
+    for (int i=0; i<3*constants::numDim; i++) {
+        ctrlPts[i] = readFloat(i+2);
+    }
+    systemCmdRsp(systemState.moveBezier(herder,ctrlPts));
+}
+
+void MessageHandler::handleAddPathPoint() {
+    Array<float,constants::numAxis> pos;
+    for (int i=0; i<constants::numAxis; i++) {
+        pos[i] = readFloat(i+1);
+    }
+    systemCmdRsp(systemState.addPathPoint(pos));
+    dprint.addIntItem(F("pathFree"), systemState.getPathFree());
+}
+
+void MessageHandler::handleGetPathFree() {
+    dprint.addIntItem(F("status"), rspSuccess);
+    dprint.addIntItem(F("pathFree"), systemState.getPathFree());
+}
+
 void MessageHandler::handleMoveToHome() {
     systemCmdRsp(systemState.moveToHome());
 }
 
 void MessageHandler::handleMoveAxisToHome() {
-    char axisName[constants::nameSize];
     int axisNumber;
-    if (!checkNumberOfArgs(2)) {return;}
-    copyString(1,axisName,constants::nameSize);
-    if (!getAxisNumberFromName(axisName,axisNumber)) {return;}
+    if (!getAxisNumberFromArg(1,axisNumber)) {return;}
     systemCmdRsp(systemState.moveAxisToHome(axisNumber));
 }
 
 void MessageHandler::handleGetPosition() {
     Array<float,constants::numAxis> position;
-    position = systemState.getPosition();
-    dprint.addFltItem("status", rspSuccess);
+    systemState.getPosition(position);
+    dprint.addIntItem(F("status"), rspSuccess);
     for (int i=0; i<constants::numAxis; i++) {
         dprint.addFltItem((char*)constants::axisNames[i],position[i]);
     }
 }
 
 void MessageHandler::handleGetAxisPosition() {
-    char axisName[constants::nameSize];
     int axisNumber;
     float pos;
-    if (!checkNumberOfArgs(2)) {return;}
-    copyString(1,axisName,constants::nameSize);
-    if (!getAxisNumberFromName(axisName,axisNumber)) {return;}
+    if (!getAxisNumberFromArg(1,axisNumber)) {return;}
     pos = systemState.getAxisPosition(axisNumber);
-    dprint.addIntItem("status", rspSuccess);
-    dprint.addFltItem("position", pos);
+    dprint.addIntItem(F("status"), rspSuccess);
+    dprint.addFltItem(F("position"), pos);
+}
+
+void MessageHandler::handleGetPositionSteps() {
+    // Position in steps - avoids formatting floats on the device. The host
+    // converts using stepsPerMM.
+    Array<long,constants::numAxis> position;
+    systemState.getPositionSteps(position);
+    dprint.addIntItem(F("status"), rspSuccess);
+    for (int i=0; i<constants::numAxis; i++) {
+        dprint.addLongItem((char*)constants::axisNames[i],position[i]);
+    }
+}
+
+void MessageHandler::handleGetSnapshot() {
+    // Positions (steps), running axes (bit mask) and timer tick count, all
+    // sampled on the same tick.
+    DriveSnapshot snapshot;
+    systemState.getSnapshot(snapshot);
+    dprint.addIntItem(F("status"), rspSuccess);
+    dprint.addLongItem(F("tick"), (long) snapshot.tick);
+    dprint.addIntItem(F("runningMask"), snapshot.runningMask);
+    for (int i=0; i<constants::numAxis; i++) {
+        dprint.addLongItem((char*)constants::axisNames[i],snapshot.position[i]);
+    }
+}
+
+void MessageHandler::handleGetAxisPositionSteps() {
+    int axisNumber;
+    if (!getAxisNumberFromArg(1,axisNumber)) {return;}
+    dprint.addIntItem(F("status"), rspSuccess);
+    dprint.addLongItem(F("position"), systemState.getAxisPositionSteps(axisNumber));
+}
+
+void MessageHandler::handleGetCaptures() {
+    // Returns, and removes, the home input captures of the axis - the step
+    // count, time (us) and edge of each - and the number of captures lost 
+    // to buffer overflow since the last call. Switch bounce is not captured.
+    int axisNumber;
+    long steps[constants::captureBufferSize];
+    unsigned long time[constants::captureBufferSize];
+    char edge[constants::captureBufferSize+1];
+    PositionCapture capture;
+    int num = 0;
+    if (!getAxisNumberFromArg(1,axisNumber)) {return;}
+    while ((num < constants::captureBufferSize) && systemState.getCapture(axisNumber,capture)) {
+        steps[num] = capture.position;
+        time[num] = capture.time;
+        edge[num] = capture.edge;
+        num++;
+    }
+    edge[num] = '\0';
+    dprint.addIntItem(F("status"), rspSuccess);
+    dprint.addLongListItem(F("steps"), steps, num);
+    dprint.addLongListItem(F("time"), time, num);
+    dprint.addStrItem(F("edge"), edge);
+    dprint.addLongItem(F("lost"), (long) systemState.getCaptureLost(axisNumber));
+}
+
+void MessageHandler::handleSetCompareOutput() {
+    int pin;
+    long pulseWidth;
+    pin = readInt(1);
+    pulseWidth = readLong(2);
+    systemCmdRsp(systemState.setCompareOutput(pin,pulseWidth));
+}
+
+void MessageHandler::handleLoadCompareTable() {
+    // Arguments are the axis name followed by up to compareTableSize 
+    // positions (mm) in increasing order. With no positions the axis' table
+    // is emptied.
+    int axisNumber;
+    float pos[constants::compareTableSize];
+    int num = numberOfItems() - 2;
+    if (num > constants::compareTableSize) {
+        errorRsp(errNumberOfArgs);
+        return;
+    }
+    if (!getAxisNumberFromArg(1,axisNumber)) {return;}
+    for (int i=0; i<num; i++) {
+        pos[i] = readFloat(i+2);
+    }
+    systemCmdRsp(systemState.loadCompareTable(axisNumber,pos,num));
+}
+
+void MessageHandler::handleSetCompareInterval() {
+    // Pulse every N steps of the axis, 0 for none.
+    int axisNumber;
+    long interval;
+    interval = readLong(2);
+    if (!getAxisNumberFromArg(1,axisNumber)) {return;}
+    systemCmdRsp(systemState.setCompareInterval(axisNumber,interval));
+}
+
+void MessageHandler::handleArmCompare() {
+    systemCmdRsp(systemState.armCompare());
+}
+
+void MessageHandler::handleClearCompare() {
+    systemState.clearCompare();
+    dprint.addIntItem(F("status"), rspSuccess);
+}
+
+void MessageHandler::handleGetCompareStatus() {
+    // Output pin (-1 if not set), pulse width (us), armed flag and the 
+    // number of pulses since the tables were armed.
+    dprint.addIntItem(F("status"), rspSuccess);
+    dprint.addIntItem(F("pin"), systemState.getCompareOutputPin());
+    dprint.addLongItem(F("pulseWidth"), (long) systemState.getComparePulseWidth());
+    dprint.addIntItem(F("armed"), systemState.isCompareArmed());
+    dprint.addLongItem(F("pulseCount"), (long) systemState.getComparePulseCount());
 }
 
 void MessageHandler::handleSetPosition() {
     Array<float,constants::numAxis> pos;
-    if (!checkNumberOfArgs(constants::numAxis+1)) {return;}
     for (int i=0; i<constants::numAxis; i++) {
         pos[i] = readFloat(i+1);
     }
@@ -538,19 +667,39 @@ void MessageHandler::handleSetPosition() {
 }
 
 void MessageHandler::handleSetAxisPosition() {
-    char axisName[constants::nameSize];
     int axisNumber;
     float pos;
-    if (!checkNumberOfArgs(3)) {return;}
-    copyString(1,axisName,constants::nameSize);
     pos = readFloat(2);
-    if (!getAxisNumberFromName(axisName,axisNumber)) {return;}
+    if (!getAxisNumberFromArg(1,axisNumber)) {return;}
     systemCmdRsp(systemState.setAxisPosition(axisNumber,pos));
 }
 
+void MessageHandler::handleGetStoredPosition() {
+    // Positions saved to EEPROM, and whether they were restored at startup
+    // and are waiting to be accepted or rejected. Stale if the axes started
+    // moving after they were saved.
+    Array<float,constants::numAxis> position;
+    systemState.getStoredPosition(position);
+    dprint.addIntItem(F("status"), rspSuccess);
+    dprint.addIntItem(F("restored"), systemState.isPositionRestored());
+    dprint.addIntItem(F("stale"), systemState.isStoredPositionStale());
+    dprint.addLongItem(F("count"), (long) systemState.getPositionStoreCount());
+    for (int i=0; i<constants::numAxis; i++) {
+        dprint.addFltItem((char*)constants::axisNames[i],position[i]);
+    }
+}
+
+void MessageHandler::handleAcceptStoredPosition() {
+    systemCmdRsp(systemState.acceptStoredPosition());
+}
+
+void MessageHandler::handleRejectStoredPosition() {
+    systemState.rejectStoredPosition();
+    dprint.addIntItem(F("status"), rspSuccess);
+}
+
 void MessageHandler::handleSetMaxSeparation() {
     Array<float,constants::numDim> maxSeparation;
-    if (!checkNumberOfArgs(constants::numDim+1)) {return;}
     for (int i=0; i<constants::numDim; i++) {
         maxSeparation[i] = readFloat(i+1);
     }
@@ -558,34 +707,58 @@ void MessageHandler::handleSetMaxSeparation() {
 }
 
 void MessageHandler::handleGetMaxSeparation() {
-    Array<float,constants::numDim> maxSeparation;
-    maxSeparation = systemState.getMaxSeparation();
-    dprint.addIntItem("status", rspSuccess);
+    const Array<float,constants::numDim> &maxSeparation = systemState.getMaxSeparation();
+    dprint.addIntItem(F("status"), rspSuccess);
     for (int i=0; i<constants::numDim; i++) {
         dprint.addFltItem((char *)constants::dimNames[i], maxSeparation[i]);
     }
 }
 
 void MessageHandler::handleSetSpeed() {
-    if (!checkNumberOfArgs(2)) {return;}
     float maxSpeed = readFloat(1);
     systemCmdRsp(systemState.setSpeed(maxSpeed));
 }
 
 void MessageHandler::handleGetSpeed() {
     float maxSpeed = systemState.getSpeed();
-    dprint.addIntItem("status", rspSuccess);
-    dprint.addFltItem("maxSpeed", maxSpeed);
+    dprint.addIntItem(F("status"), rspSuccess);
+    dprint.addFltItem(F("maxSpeed"), maxSpeed);
+}
+
+void MessageHandler::handleGetFeedOverride() {
+    // The feed override is set with the fast path feedOverrideByte
+    dprint.addIntItem(F("status"), rspSuccess);
+    dprint.addIntItem(F("feedOverride"), systemState.getFeedOverride());
+    dprint.addIntItem(F("feedOverrideTarget"), systemState.getFeedOverrideTarget());
+}
+
+void MessageHandler::handleSetAcceleration() {
+    float accel = readFloat(1);
+    systemCmdRsp(systemState.setAcceleration(accel));
+}
+
+void MessageHandler::handleGetAcceleration() {
+    dprint.addIntItem(F("status"), rspSuccess);
+    dprint.addFltItem(F("acceleration"), systemState.getAcceleration());
+}
+
+void MessageHandler::handleSetJunctionDeviation() {
+    float deviation = readFloat(1);
+    systemCmdRsp(systemState.setJunctionDeviation(deviation));
+}
+
+void MessageHandler::handleGetJunctionDeviation() {
+    dprint.addIntItem(F("status"), rspSuccess);
+    dprint.addFltItem(F("junctionDeviation"), systemState.getJunctionDeviation());
 }
 
 void MessageHandler::handleIsInHomePosition() {
-    dprint.addIntItem("status", rspSuccess);
-    dprint.addIntItem("isInHomePosition", systemState.isInHomePosition());
+    dprint.addIntItem(F("status"), rspSuccess);
+    dprint.addIntItem(F("isInHomePosition"), systemState.isInHomePosition());
 }
 
 void MessageHandler::handleSetOrientation() {
     Array<char,constants::numAxis> orientation;
-    if (!checkNumberOfArgs(constants::numAxis+1)) {return;}
     for (int i=0; i<constants::numAxis; i++) {
         orientation[i] = readChar(i+1,0);
     }
@@ -593,48 +766,41 @@ void MessageHandler::handleSetOrientation() {
 }
 
 void MessageHandler::handleGetOrientation() {
-    Array<char,constants::numAxis> orientation = systemState.getOrientation();
-    dprint.addIntItem("status", rspSuccess);
+    const Array<char,constants::numAxis> &orientation = systemState.getOrientation();
+    dprint.addIntItem(F("status"), rspSuccess);
     for (int i=0; i<constants::numAxis; i++) {
         dprint.addCharItem((char*)constants::axisNames[i],orientation[i]);
     }
 }
 
 void MessageHandler::handleSetAxisOrientation() {
-    char axisName[constants::nameSize];
     int axisNumber;
     char orientation;
-    if (!checkNumberOfArgs(3)) {return;}
-    copyString(1,axisName,constants::nameSize);
     orientation = readChar(2,0);
-    if (!getAxisNumberFromName(axisName,axisNumber)) {return;}
+    if (!getAxisNumberFromArg(1,axisNumber)) {return;}
     systemCmdRsp(systemState.setAxisOrientation(axisNumber,orientation));
-    dprint.addIntItem("status", rspSuccess);
+    dprint.addIntItem(F("status"), rspSuccess);
 }
 
 void MessageHandler::handleGetAxisOrientation() {
-    char axisName[constants::nameSize];
     int axisNumber;
     char orientation;
-    if (!checkNumberOfArgs(2)) {return;}
-    copyString(1,axisName,constants::nameSize);
-    if (!getAxisNumberFromName(axisName, axisNumber)) {return;}
+    if (!getAxisNumberFromArg(1,axisNumber)) {return;}
     orientation = systemState.getAxisOrientation(axisNumber);
-    dprint.addIntItem("status", rspSuccess);
-    dprint.addCharItem("orientation",orientation);
+    dprint.addIntItem(F("status"), rspSuccess);
+    dprint.addCharItem(F("orientation"),orientation);
 }
 
 void MessageHandler::handleSetStepsPerMM() {
     float stepsPerMM;
-    if (!checkNumberOfArgs(2)) {return;}
     stepsPerMM = readFloat(1);
     systemCmdRsp(systemState.setStepsPerMM(stepsPerMM));
 }
 
 void MessageHandler::handleGetStepsPerMM() {
     float stepsPerMM = systemState.getStepsPerMM();
-    dprint.addIntItem("status", rspSuccess);
-    dprint.addFltItem("stepsPerMillimeter", stepsPerMM);
+    dprint.addIntItem(F("status"), rspSuccess);
+    dprint.addFltItem(F("stepsPerMillimeter"), stepsPerMM);
 }
 
 void MessageHandler::handleEnableBoundsCheck() {
@@ -643,35 +809,59 @@ void MessageHandler::handleEnableBoundsCheck() {
 
 void MessageHandler::handleDisableBoundsCheck() {
     systemState.disableBoundsCheck();
-    dprint.addIntItem("status", rspSuccess);
+    dprint.addIntItem(F("status"), rspSuccess);
 }
 
 void MessageHandler::handleIsBoundsCheckEnabled() {
-    dprint.addIntItem("status", rspSuccess);
-    dprint.addIntItem("isBoundsCheckEnabled", systemState.isBoundsCheckEnabled());
+    dprint.addIntItem(F("status"), rspSuccess);
+    dprint.addIntItem(F("isBoundsCheckEnabled"), systemState.isBoundsCheckEnabled());
 }
 
 void MessageHandler::handleSetSerialNumber() {
     // NOT DONE
-    dprint.addIntItem("status", rspSuccess);
+    dprint.addIntItem(F("status"), rspSuccess);
 }
 
 void MessageHandler::handleGetSerialNumber() {
-    dprint.addIntItem("status", rspSuccess);
-    dprint.addIntItem("serialNumber", (int) constants::deviceSerialNumber);
+    dprint.addIntItem(F("status"), rspSuccess);
+    dprint.addIntItem(F("serialNumber"), (int) constants::deviceSerialNumber);
 }
 
 void MessageHandler::handleGetModelNumber() {
-    dprint.addIntItem("status", rspSuccess);
-    dprint.addIntItem("modelNumber", (int) constants::deviceModelNumber);
+    dprint.addIntItem(F("status"), rspSuccess);
+    dprint.addIntItem(F("modelNumber"), (int) constants::deviceModelNumber);
+}
+
+void MessageHandler::handleGetSerialStats() {
+    SerialTxStats stats;
+    serialPort.getTxStats(stats);
+    dprint.addIntItem(F("status"), rspSuccess);
+    dprint.addLongItem(F("txFree"), (long) stats.free);
+    dprint.addLongItem(F("txHighWater"), (long) stats.highWater);
+    dprint.addLongItem(F("txBlocked"), (long) stats.blocked);
+    dprint.addLongItem(F("txPriorityDropped"), (long) stats.priorityDropped);
+    dprint.addLongItem(F("rxOverflow"), (long) stats.rxOverflow);
+    dprint.addLongItem(F("frameNak"), (long) framer.getNakCount());
+    dprint.addLongItem(F("frameReplay"), (long) framer.getReplayCount());
 }
 
 // -------------------------------------------------
 
 
+void MessageHandler::handleGetCmdArgs() {
+    // The argument types of each command, from the command table. See
+    // CommandTable.h.
+    CommandInfo info;
+    dprint.addIntItem(F("status"), rspSuccess);
+    for (int i=0; i<numCmds; i++) {
+        readCommandInfo(i,info);
+        dprint.addStrItem((const __FlashStringHelper *) info.name, (const __FlashStringHelper *) info.args);
+    }
+}
+
 void MessageHandler::handleDebug() {
     char name[20];
-    dprint.addIntItem("status", rspSuccess);
+    dprint.addIntItem(F("status"), rspSuccess);
 }
 
 
@@ -1,73 +1,50 @@
 #ifndef _MESSAGE_HANDER_H_
 #define _MESSAGE_HANDER_H_
-#include <SerialReceiver.h>
-#include "DictPrinter.h"
+#include "CommandParser.h"
+#include "CommandTable.h"
+#include "ReplyPrinter.h"
+#include "FrameLink.h"
 #include "constants.h"
 
-class MessageHandler : public SerialReceiver {
+// Axis name hash table size, a power of two
+enum {AXIS_HASH_SZ=8};
+
+class MessageHandler : public CommandParser {
 
     public:
+        MessageHandler();
         void processMsg();
+        void sendReady();
 
     private:
-        DictPrinter dprint;
+        FrameLink framer;
+        ReplyPrinter dprint;
+        bool framedReply;
+        int8_t axisHashTable[AXIS_HASH_SZ];
+        bool axisHashPerfect;
+        void processFrame();
         void msgSwitchYard();
-        bool checkNumberOfArgs(int num);
+        bool checkArgs(const char *args);
+        bool checkArg(int item, char type);
         bool checkAxisArg(int axis);
-        bool getAxisNumberFromName(char *axisName, int &number);
+        bool getAxisNumberFromArg(int item, int &number);
         void systemCmdRsp(bool flag);
-
-        void handleGetDevInfo();
-        void handleGetCmds();
-        void handleGetRspCodes();
-        void handleGetAxisNames();
-        void handleGetDimNames();
-        void handleGetNumAxis();
-        void handleGetNumDim();
-        void handleGetAxisOrder();
-        void handleGetDimOrder();
-        void handleGetAllowedOrientation();
-
-        void handleSetDrivePowerOn();
-        void handleSetDrivePowerOff();
-        void handleIsDrivePowerOn();
-
-        void handleStop();
-        void handleIsRunning();
-#ifdef HAVE_ENABLE
-        void handleEnable();
-        void handleDisable();
-        void handleIsEnabled();
-#endif
-        void handleMoveToPosition();
-        void handleMoveAxisToPosition();
-        void handleMoveToHome();
-        void handleMoveAxisToHome();
-        void handleGetPosition();
-        void handleGetAxisPosition();
-        void handleSetPosition();
-        void handleSetAxisPosition();
-        void handleSetMaxSeparation();
-        void handleGetMaxSeparation();
-        void handleSetSpeed();
-        void handleGetSpeed();
-        void handleIsInHomePosition();
-        void handleSetOrientation();
-        void handleGetOrientation();
-        void handleSetAxisOrientation();
-        void handleGetAxisOrientation();
-        void handleSetStepsPerMM();
-        void handleGetStepsPerMM();
-        void handleEnableBoundsCheck();
-        void handleDisableBoundsCheck();
-        void handleIsBoundsCheckEnabled();
-        void handleSetSerialNumber();
-        void handleGetSerialNumber();
-        void handleGetModelNumber();
-
-        // Development
-        void handleGetTimerCount();
-        void handleDebug();
+        void errorRsp(uint8_t code);
+        void sendEvent(const __FlashStringHelper *name);
+
+        // One handler per command, handleName for each entry in CommandTable.h
+#define CMD_HANDLER(Name, name, args) void handle##Name();
+        COMMAND_TABLE(CMD_HANDLER)
+#undef CMD_HANDLER
+
+        // Command table entry. The table and its strings are kept in flash.
+        struct CommandInfo {
+            const char *name;
+            const char *args;
+            void (MessageHandler::*handler)();
+        };
+        static const CommandInfo commandTable[];
+        void readCommandInfo(int cmd, CommandInfo &info);
 };
 
 extern MessageHandler messageHandler;
@@ -13,13 +13,72 @@ MotorDrive::MotorDrive()
     _powerPin = constants::drivePowerPin;
     _faultPin = constants::driveFaultPin;
     _powerOnFlag = false;
+    _readyFlag = false;
+    _readyEvent = false;
+    _powerOnTime = 0;
+    _period = 0;
+    _timerPeriod = 0;
+    _minPeriod = 1;
+    _feedTarget = constants::feedOverrideDefault;
+    _feedPercent = constants::feedOverrideDefault;
+    _feedTime = 0;
+    _pathActive = false;
+    _pathBlockLoaded = false;
+    _pathRate = 0.0;
+    _pathMinRate = 1.0;
+    _pathPeriod = 0;
+    _pathTicks = 0;
+    _pathTime = 0;
+    _runningMask = 0;
+    _homingMask = 0;
+    _armedMask = 0;
+    _knownMask = 0;
+    _snapshotSeq = 0;
+    _tickCount = 0;
+    _triggerPending = false;
+    _triggerTime = 0;
+    _triggerIsrTime = -1;
+    _compareMask = 0;
+    _comparePortReg = 0;
+    _compareBitMask = 0;
+    _comparePulseWidth = 0;
+    _comparePulseActive = false;
+    _comparePulseStart = 0;
+    _comparePulseCount = 0;
+    _dirInvertedMask = 0;
+    _stepInvertedMask = 0;
+    _faultPortReg = 0;
+    _faultBitMask = 0;
+    _faultActiveBits = 0;
+    _faultFlag = false;
+    _faultEvent = false;
+    _faultTime = 0;
+    _faultAxisMask = 0;
+    _stopLatched = false;
+    for (int i=0; i<constants::numAxis; i++) {
+        _currentPos[i] = 0;
+        _snapshotPos[0][i] = 0;
+        _snapshotPos[1][i] = 0;
+        _faultPos[i] = 0;
+        _targetPos[i] = 0;
+        _rateNum[i] = 1;
+        _rateDen[i] = 1;
+        _rateAccum[i] = 0;
+        _stepPortReg[i] = 0;
+        _dirPortReg[i] = 0;
+        _stepBitMask[i] = 0;
+        _dirBitMask[i] = 0;
+    }
 #ifdef HAVE_ENABLE
     _enabledFlag = false;
     _disablePin = constants::driveDisablePin;
 #else
     _enabledFlag = true;
 #endif
-
+    for (int j=0; j<2; j++) {
+        _snapshotRunning[j] = 0;
+        _snapshotTick[j] = 0;
+    }
 }
 
 MotorDrive::MotorDrive(int powerPin, int disablePin, int faultPin) {
@@ -35,6 +94,9 @@ void MotorDrive::initialize() {
     // Set pin modes for drive control pins
     pinMode(_powerPin, OUTPUT);
     pinMode(_faultPin, INPUT);
+    _faultPortReg = portInputRegister(digitalPinToPort(_faultPin));
+    _faultBitMask = digitalPinToBitMask(_faultPin);
+    _faultActiveBits = (constants::driveFaultActiveLevel == HIGH) ? _faultBitMask : 0;
     setPowerOff();
 #ifdef HAVE_ENABLE
     pinMode(_disablePin, OUTPUT); 
@@ -50,9 +112,16 @@ void MotorDrive::initialize() {
                 constants::homePinArray[i]
                 );
         _stepper[i].initialize();
+        _stepPortReg[i] = _stepper[i].getStepPortReg();
+        _stepBitMask[i] = _stepper[i].getStepBitMask();
+        _dirPortReg[i] = _stepper[i].getDirPortReg();
+        _dirBitMask[i] = _stepper[i].getDirBitMask();
     }
+    _dirInvertedMask = 0;
+    _stepInvertedMask = 0;
 
     // Initialize timer and set default speed
+    setMinPeriod(1000000/(long)(constants::maxSpeed*constants::stepsPerMMDefault));
     speedInSteps = (unsigned int)(constants::speedDefault*constants::stepsPerMMDefault);  
     setSpeed(speedInSteps); 
 }
@@ -78,7 +147,11 @@ bool MotorDrive::isEnabled() {
 void MotorDrive::stop(unsigned int i) {
     if (i<constants::numAxis) {
         ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
-            _stepper[i].stop();
+            clearPath();
+            clearCurve(i/constants::numDim);
+            _runningMask &= ~(1 << i);
+            _homingMask &= ~(1 << i);
+            _armedMask &= ~(1 << i);
         } 
     }
 }
@@ -86,39 +159,107 @@ void MotorDrive::stop(unsigned int i) {
 void MotorDrive::start(unsigned int i) {
     if (i<constants::numAxis) {
         ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
-            _stepper[i].start();
+            if (!_stopLatched) {
+                startAxis(i);
+            }
         }
     }
 }
 
 void MotorDrive::stopAll() {
     ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
-        for (int i=0; i<constants::numAxis; i++) {
-            _stepper[i].stop();
+        clearPath();
+        for (int h=0; h<constants::numHerder; h++) {
+            clearCurve(h);
         }
+        _runningMask = 0;
+        _homingMask = 0;
+        _armedMask = 0;
+        _triggerPending = false;
+    }
+}
+
+void MotorDrive::emergencyStop() {
+    // Stops all axes and latches the stop, see _stopLatched
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        _stopLatched = true;
+        stopAll();
+    }
+}
+
+bool MotorDrive::isStopLatched() {
+    return _stopLatched;
+}
+
+void MotorDrive::releaseStop() {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        _stopLatched = false;
     }
 }
 
 void MotorDrive::startAll() {
     ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
-        for (int i=0; i<constants::numAxis; i++) {
-            _stepper[i].start();
+        if (!_stopLatched) {
+            for (int i=0; i<constants::numAxis; i++) {
+                startAxis(i);
+            }
         }
     }
 }
 
+void MotorDrive::armAll() {
+    // Arms all axes to move to their target positions. Nothing moves until 
+    // startArmed is called.
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        if (!_stopLatched) {
+            _armedMask = (1 << constants::numAxis) - 1;
+        }
+    }
+}
+
+bool MotorDrive::isArmed() {
+    return (_armedMask != 0);
+}
+
+void MotorDrive::cancelArmed() {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        _armedMask = 0;
+    }
+}
+
+long MotorDrive::getTriggerIsrTime() {
+    // Time (us) the last trigger interrupt took from its entry to the first
+    // step, -1 if there has been no triggered start. The interrupt entry
+    // latency after the input edge is not included.
+    long isrTime;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        isrTime = _triggerIsrTime;
+    }
+    return isrTime;
+}
+
 void MotorDrive::home(unsigned int i) {
     if (i < constants::numAxis) {
         ATOMIC_BLOCK(ATOMIC_RESTORESTATE) { 
-            _stepper[i].home(); 
+            if (!_stopLatched) {
+                clearPath();
+                clearCurve(i/constants::numDim);
+                homeAxis(i);
+            }
         }
     }
 }
 
 void MotorDrive::homeAll() {
     ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
-        for (int i=0; i<constants::numAxis; i++) {
-            _stepper[i].home();
+        if (!_stopLatched) {
+            clearPath();
+            for (int h=0; h<constants::numHerder; h++) {
+                clearCurve(h);
+            }
+            for (int i=0; i<constants::numAxis; i++) {
+                homeAxis(i);
+            }
         }
     }
 }
@@ -127,24 +268,168 @@ bool MotorDrive::isPowerOn() {
     return _powerOnFlag;
 }
 
+bool MotorDrive::checkReady() {
+    // Called from the timer interrupt while the drive is powered but not yet 
+    // ready. The drive is ready once the power has settled and the fault 
+    // input is clear.
+    if ((millis() - _powerOnTime) < constants::drivePowerSettleTime) {
+        return false;
+    }
+    if ((*_faultPortReg & _faultBitMask) == _faultActiveBits) {
+        return false;
+    }
+    _readyFlag = true;
+    _readyEvent = true;
+    return true;
+}
+
+bool MotorDrive::isReady() {
+    return _readyFlag;
+}
+
+bool MotorDrive::checkReadyEvent() {
+    // Returns true, once, after the drive has become ready.
+    bool flag = false;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        flag = _readyEvent;
+        _readyEvent = false;
+    }
+    return flag;
+}
+
+void MotorDrive::latchFault() {
+    // Called from the timer interrupt when the fault input becomes active.
+    // Stops all axes and holds them stopped until the fault is cleared.
+    _faultFlag = true;
+    _faultEvent = true;
+    _faultTime = millis();
+    _faultAxisMask = _runningMask;
+    _knownMask &= ~_faultAxisMask;
+    for (uint8_t i=0; i<constants::numAxis; i++) {
+        _faultPos[i] = _currentPos[i];
+    }
+    stopAll();
+}
+
+bool MotorDrive::isFault() {
+    return _faultFlag;
+}
+
+bool MotorDrive::isFaultInputActive() {
+    return (*_faultPortReg & _faultBitMask) == _faultActiveBits;
+}
+
+bool MotorDrive::checkFaultEvent() {
+    // Returns true, once, after a fault has been latched.
+    bool flag = false;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        flag = _faultEvent;
+        _faultEvent = false;
+    }
+    return flag;
+}
+
+bool MotorDrive::clearFault() {
+    // Clears the latched fault. Fails if the fault input is still active.
+    if (isFaultInputActive()) {
+        return false;
+    }
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        _faultFlag = false;
+        _faultEvent = false;
+    }
+    return true;
+}
+
+unsigned long MotorDrive::getFaultTime() {
+    unsigned long faultTime;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        faultTime = _faultTime;
+    }
+    return faultTime;
+}
+
+uint8_t MotorDrive::getFaultAxisMask() {
+    return _faultAxisMask;
+}
+
+void MotorDrive::getFaultPositionAll(Array<long, constants::numAxis> &pos) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        for (int i=0; i<constants::numAxis; i++) {
+            pos[i] = _faultPos[i];
+        }
+    }
+}
+
+
+void MotorDrive::homeAxis(uint8_t i) {
+    // Should be called in an atomic block. Sets the axis in motion towards 
+    // its home switch, or to the home position if already on the switch.
+    uint8_t bit = 1 << i;
+    long dist = _stepper[i].getHomeSearchDist();
+    if (_stepper[i].isHomeInputActive()) {
+        _runningMask &= ~bit;
+        _homingMask &= ~bit;
+        _knownMask |= bit;
+        _currentPos[i] = _stepper[i].getHomePosition();
+        publishSnapshot();
+    }
+    else {
+        if (_stepper[i].getHomeSearchDir() == '+') {
+            _targetPos[i] = _currentPos[i] + dist;
+        }
+        else {
+            _targetPos[i] = _currentPos[i] - dist;
+        }
+        _homingMask |= bit;
+        startAxis(i);
+    }
+}
 
 bool MotorDrive::isRunning() {
     bool flag = false;
-    for (int i=0; i<constants::numAxis; i++) {
-        if (_stepper[i].isRunning()) {
+    if (_runningMask != 0) {
+        flag = true;
+    }
+    for (int h=0; h<constants::numHerder; h++) {
+        if (_curve[h].isActive()) {
             flag = true;
         }
     }
+    if (_pathActive) {
+        flag = true;
+    }
     return flag;
 }
+
+bool MotorDrive::isAxisRunning(unsigned int i) {
+    if (i < constants::numAxis) {
+        return (_runningMask & (1 << i)) != 0;
+    }
+    else {
+        return false;
+    }
+}
+
 void MotorDrive::setPowerOn() {
-    digitalWrite(_powerPin,HIGH);
-    _powerOnFlag = true;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        if (!_powerOnFlag) {
+            _powerOnTime = millis();
+            _readyFlag = false;
+            _readyEvent = false;
+        }
+        digitalWrite(_powerPin,HIGH);
+        _powerOnFlag = true;
+    }
 }
 
 void MotorDrive::setPowerOff() {
-    digitalWrite(_powerPin,LOW);
-    _powerOnFlag = false;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        digitalWrite(_powerPin,LOW);
+        _powerOnFlag = false;
+        _readyFlag = false;
+        _readyEvent = false;
+    }
 #ifdef HAVE_ENABLE
     disable();
 #endif
@@ -152,9 +437,74 @@ void MotorDrive::setPowerOff() {
 
 void MotorDrive::setSpeed(unsigned int v) {
     long period = 1000000/v;
+    setPeriod(period);
+}
+
+void MotorDrive::setPeriod(long period) {
+    // While a path is running the timer period is set by the path and the 
+    // new period is applied when the path ends.
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        _period = period;
+        if (!_pathActive) {
+            setTimerPeriod(getScaledPeriod());
+        }
+    }
+}
+
+void MotorDrive::setMinPeriod(long period) {
+    // Shortest timer period, that of constants::maxSpeed. A feed override
+    // above 100% is not allowed to run the timer any faster.
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        _minPeriod = period;
+        if (!_pathActive) {
+            setTimerPeriod(getScaledPeriod());
+        }
+    }
+}
+
+void MotorDrive::setTimerPeriod(long period) {
+    // Should be called in an atomic block
+    _timerPeriod = period;
     Timer1.setPeriod(period);
 }
 
+void MotorDrive::setFeedOverride(uint8_t percent) {
+    // Sets the target feed override (%). Safe to call from an interrupt.
+    _feedTarget = constrain(percent, constants::feedOverrideMin, constants::feedOverrideMax);
+}
+
+uint8_t MotorDrive::getFeedOverride() {
+    return _feedPercent;
+}
+
+uint8_t MotorDrive::getFeedOverrideTarget() {
+    return _feedTarget;
+}
+
+void MotorDrive::setRate(unsigned int i, long num, long den) {
+    if (i < constants::numAxis) {
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+            loadRate(i,num,den);
+        }
+    }
+}
+
+void MotorDrive::setRateAll(const Array<long, constants::numAxis> &num, long den) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        for (int i=0; i<constants::numAxis; i++) {
+            loadRate(i,num[i],den);
+        }
+    }
+}
+
+void MotorDrive::setRateAllToDefault() {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        for (int i=0; i<constants::numAxis; i++) {
+            loadRate(i,1,1);
+        }
+    }
+}
+
 void MotorDrive::setDirection(unsigned int i, char dir) {
     if (i < constants::numAxis) {
         if (dir == constants::orientationInverted) {
@@ -163,37 +513,74 @@ void MotorDrive::setDirection(unsigned int i, char dir) {
         else {
             _stepper[i].setDirNormal();
         }
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+            if (_stepper[i].isDirInverted()) {
+                _dirInvertedMask |= (1 << i);
+            }
+            else {
+                _dirInvertedMask &= ~(1 << i);
+            }
+            if (_stepper[i].isStepInverted()) {
+                _stepInvertedMask |= (1 << i);
+            }
+            else {
+                _stepInvertedMask &= ~(1 << i);
+            }
+        }
     }
 }
-void MotorDrive::setDirectionAll(Array<char,constants::numAxis> dir) {
+void MotorDrive::setDirectionAll(const Array<char,constants::numAxis> &dir) {
     for (int i=0; i<constants::numAxis; i++) {
         setDirection(i,dir[i]);
     }
 }
 
-Array<long, constants::numAxis> MotorDrive::getCurrentPositionAll() {
-    Array<long, constants::numAxis> position;
+void MotorDrive::getCurrentPositionAll(Array<long, constants::numAxis> &pos) {
+    DriveSnapshot snapshot;
+    getSnapshot(snapshot);
     for (int i=0; i<constants::numAxis; i++) {
-        position[i] = _stepper[i].getCurrentPosition();
+        pos[i] = snapshot.position[i];
     }
-    return position;
 }
 
 long MotorDrive::getCurrentPosition(unsigned int i) {
-    long rtnVal = 0;
-    if (i < constants::numAxis) {
-        rtnVal = _stepper[i].getCurrentPosition();
+    DriveSnapshot snapshot;
+    if (i >= constants::numAxis) {
+        return 0;
     }
-    return rtnVal;
+    getSnapshot(snapshot);
+    return snapshot.position[i];
+}
+
+void MotorDrive::getSnapshot(DriveSnapshot &snapshot) {
+    // Copies the last published snapshot, retrying if the timer interrupt 
+    // publishes another during the copy. The positions are all from the same
+    // tick. 
+    uint8_t seq;
+    uint8_t j;
+    do {
+        seq = _snapshotSeq;
+        j = seq & 1;
+        for (int i=0; i<constants::numAxis; i++) {
+            snapshot.position[i] = _snapshotPos[j][i];
+        }
+        snapshot.runningMask = _snapshotRunning[j];
+        snapshot.tick = _snapshotTick[j];
+    } while (seq != _snapshotSeq);
 }
 
 void MotorDrive::setCurrentPosition(unsigned int i, long pos) {
     if (i < constants::numAxis) {
-        _stepper[i].setCurrentPosition(pos);
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+            _targetPos[i] = pos;
+            _currentPos[i] = pos;
+            _knownMask |= (1 << i);
+            publishSnapshot();
+        }
     }
 }
 
-void MotorDrive::setCurrentPositionAll(Array<long, constants::numAxis> pos) {
+void MotorDrive::setCurrentPositionAll(const Array<long, constants::numAxis> &pos) {
     for (int i=0; i<constants::numAxis; i++) {
         setCurrentPosition(i,pos[i]);
     }
@@ -202,15 +589,21 @@ void MotorDrive::setCurrentPositionAll(Array<long, constants::numAxis> pos) {
 void MotorDrive::setTargetPosition(unsigned int i, long pos) {
     if (i < constants::numAxis) {
         ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
-            _stepper[i].setTargetPosition(pos);
+            clearPath();
+            clearCurve(i/constants::numDim);
+            _targetPos[i] = pos;
         }
     }
 }
 
-void MotorDrive::setTargetPositionAll(Array<long,constants::numAxis> pos) {
+void MotorDrive::setTargetPositionAll(const Array<long,constants::numAxis> &pos) {
     ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        clearPath();
+        for (int h=0; h<constants::numHerder; h++) {
+            clearCurve(h);
+        }
         for (int i=0; i<constants::numAxis; i++) {
-            _stepper[i].setTargetPosition(pos[i]);
+            _targetPos[i] = pos[i];
         }
     }
 }
@@ -221,7 +614,7 @@ void MotorDrive::setHomePosition(unsigned int i, long pos) {
     }
 }
 
-void MotorDrive::setHomePositionAll(Array<long, constants::numAxis> pos) {
+void MotorDrive::setHomePositionAll(const Array<long, constants::numAxis> &pos) {
     for (int i=0; i<constants::numAxis; i++) {
         setHomePosition(i,pos[i]);
     }
@@ -236,17 +629,15 @@ long MotorDrive::getHomePosition(unsigned int i) {
     }
 }
 
-Array<long, constants::numAxis> MotorDrive::getHomePositionAll() {
-    Array<long, constants::numAxis> pos;
+void MotorDrive::getHomePositionAll(Array<long, constants::numAxis> &pos) {
     for (int i=0; i<constants::numAxis; i++) {
         pos[i] = getHomePosition(i);
     }
-    return pos;
 }
 
 bool MotorDrive::isHome(unsigned int i) {
     if (i<constants::numAxis) {
-        return _stepper[i].isHome();
+        return (getCurrentPosition(i) == _stepper[i].getHomePosition());
     }
     else {
         return false;
@@ -261,13 +652,25 @@ bool MotorDrive::isHomeAll() {
     return homeFlag;
 }
 
+bool MotorDrive::isPositionKnownAll() {
+    // True if every axis has been homed, or had its position set, since the
+    // last reset and has not been stopped by a drive fault while running.
+    return (_knownMask == (1 << constants::numAxis) - 1);
+}
+
+void MotorDrive::setPositionKnownAll(bool known) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        _knownMask = known ? (1 << constants::numAxis) - 1 : 0;
+    }
+}
+
 void MotorDrive::setHomeSearchDir(unsigned int i, char dir) {
     if (i < constants::numAxis)  {
         _stepper[i].setHomeSearchDir(dir);
     }
 }
 
-void MotorDrive::setHomeSearchDirAll(Array<char, constants::numAxis> dir) {
+void MotorDrive::setHomeSearchDirAll(const Array<char, constants::numAxis> &dir) {
     for (int i=0; i<constants::numAxis; i++) {
         setHomeSearchDir(i,dir[i]);
     }
@@ -282,8 +685,7 @@ char MotorDrive::getHomeSearchDir(unsigned int i) {
     }
 }
 
-Array<char, constants::numAxis> MotorDrive::getHomeSearchDir() {
-    Array<char, constants::numAxis> dir;
+void MotorDrive::getHomeSearchDirAll(Array<char, constants::numAxis> &dir) {
     for (int i=0; i<constants::numAxis; i++) {
         dir[i] = getHomeSearchDir(i); 
     }
@@ -295,7 +697,7 @@ void MotorDrive::setHomeSearchDist(unsigned int i, long dist) {
     }
 }
 
-void MotorDrive::setHomeSearchDistAll(Array<long, constants::numAxis> dist) {
+void MotorDrive::setHomeSearchDistAll(const Array<long, constants::numAxis> &dist) {
     for (int i=0; i<constants::numAxis; i++) {
         setHomeSearchDist(i,dist[i]);
     }
@@ -310,19 +712,276 @@ long MotorDrive::getHomeSearchDist(unsigned int i) {
     }
 }
 
-Array<long, constants::numAxis> MotorDrive::getHomeSearchDist() {
-    Array<long, constants::numAxis> dist;
+void MotorDrive::getHomeSearchDistAll(Array<long, constants::numAxis> &dist) {
     for (int i=0; i<constants::numAxis; i++) {
         dist[i] = getHomeSearchDist(i);
     }
 }
 
 void MotorDrive::homeAction(unsigned int i) {
-    if (_enabledFlag && _powerOnFlag) {
-        if (i < constants::numAxis) {
-            _stepper[i].homeAction();
+    // Runs on every edge of the axis' home input. Latches the step count and 
+    // time of the edge, before any homing reset, so that lost steps show up 
+    // as drift in the captured switch positions. Bounce is dropped by the 
+    // capture buffer. Homing only acts on the edge where the switch closes.
+    bool active;
+    if (i >= constants::numAxis) {
+        return;
+    }
+    active = _stepper[i].isHomeInputActive();
+    _capture[i].add(_currentPos[i], micros(), active ? 'F' : 'R');
+    if (_enabledFlag && _powerOnFlag && active) {
+        if (_homingMask & (1 << i)) {
+            _homingMask &= ~(1 << i);
+            _runningMask &= ~(1 << i);
+            _knownMask |= (1 << i);
+            _currentPos[i] = _stepper[i].getHomePosition();
+            publishSnapshot();
+        }
+    }
+}
+
+void MotorDrive::setCompareOutput(int pin, unsigned int pulseWidth) {
+    // Sets the compare output pin and pulse width (us). Disarms the compare
+    // tables.
+    pinMode(pin, OUTPUT);
+    digitalWrite(pin, LOW);
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        if (_comparePulseActive) {
+            *_comparePortReg &= ~_compareBitMask;
+            _comparePulseActive = false;
+        }
+        _compareMask = 0;
+        _comparePortReg = portOutputRegister(digitalPinToPort(pin));
+        _compareBitMask = digitalPinToBitMask(pin);
+        _comparePulseWidth = pulseWidth;
+    }
+}
+
+bool MotorDrive::loadCompareTable(unsigned int i, const long *pos, uint8_t num) {
+    // Loads the compare positions (steps, increasing) of axis i. Disarms the
+    // axis' table.
+    if (i >= constants::numAxis) {
+        return false;
+    }
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        _compareMask &= ~(1 << i);
+    }
+    return _compare[i].load(pos,num);
+}
+
+bool MotorDrive::setCompareInterval(unsigned int i, long interval) {
+    // Sets axis i to pulse every interval steps, 0 for none. Disarms the 
+    // axis' table.
+    if (i >= constants::numAxis) {
+        return false;
+    }
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        _compareMask &= ~(1 << i);
+    }
+    _compare[i].setInterval(interval);
+    return true;
+}
+
+bool MotorDrive::armCompare() {
+    // Arms the compare tables of all axes which have positions or an interval
+    // loaded. Returns false if the output pin has not been set or no table 
+    // is loaded.
+    uint8_t mask = 0;
+    if (_comparePortReg == 0) {
+        return false;
+    }
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        for (uint8_t i=0; i<constants::numAxis; i++) {
+            if (!_compare[i].isEmpty()) {
+                _compare[i].arm(_currentPos[i]);
+                mask |= (1 << i);
+            }
+        }
+        _compareMask = mask;
+        _comparePulseCount = 0;
+    }
+    return (mask != 0);
+}
+
+void MotorDrive::clearCompare() {
+    // Disarms and clears the compare tables of all axes.
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        _compareMask = 0;
+    }
+    for (uint8_t i=0; i<constants::numAxis; i++) {
+        _compare[i].clear();
+    }
+}
+
+bool MotorDrive::isCompareArmed() {
+    return (_compareMask != 0);
+}
+
+unsigned long MotorDrive::getComparePulseCount() {
+    // Number of compare pulses since the tables were armed.
+    unsigned long count;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        count = _comparePulseCount;
+    }
+    return count;
+}
+
+bool MotorDrive::getCapture(unsigned int i, PositionCapture &capture) {
+    if (i >= constants::numAxis) {
+        return false;
+    }
+    return _capture[i].get(capture);
+}
+
+uint16_t MotorDrive::getCaptureLost(unsigned int i) {
+    if (i >= constants::numAxis) {
+        return 0;
+    }
+    return _capture[i].getLostAndClear();
+}
+
+void MotorDrive::startCurve(unsigned int h, CurveGen &curve) {
+    // Ignored while a path is active, the path owns all axes until it ends,
+    // and while an emergency stop is latched.
+    unsigned int ix = h*constants::numDim;
+    if (h < constants::numHerder) {
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+            if (!_pathActive && !_stopLatched) {
+                _runningMask &= ~((1 << ix) | (1 << (ix+1)));
+                _curve[h] = curve;
+            }
+        }
+    }
+}
+
+void MotorDrive::stopCurve(unsigned int h) {
+    unsigned int ix = h*constants::numDim;
+    if (h < constants::numHerder) {
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+            clearCurve(h);
+            _runningMask &= ~((1 << ix) | (1 << (ix+1)));
         }
     }
 }
 
+bool MotorDrive::isCurveActive(unsigned int h) {
+    if (h < constants::numHerder) {
+        return _curve[h].isActive();
+    }
+    else {
+        return false;
+    }
+}
+
+void MotorDrive::clearCurve(uint8_t h) {
+    // Should be called in an atomic block. Returns the herder's axes to the 
+    // default rate if they were left at a chord's rate.
+    unsigned int ix = h*constants::numDim;
+    if (_curve[h].isActive()) {
+        _curve[h].clear();
+        loadRate(ix,1,1);
+        loadRate(ix+1,1,1);
+    }
+}
+
+void MotorDrive::setPathParams(float accel, float deviation, float minRate) {
+    // Acceleration (steps/s^2), junction deviation (steps) and minimum rate
+    // (steps/s) used for continuous paths.
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        _path.setAcceleration(accel);
+        _path.setJunctionDeviation(deviation);
+        _pathMinRate = minRate;
+    }
+}
 
+bool MotorDrive::addPathSegment(const Array<long, constants::numAxis> &target, float nominalRate) {
+    long pos[constants::numAxis];
+    bool active;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        active = _pathActive;
+    }
+    if (!active) {
+        for (int i=0; i<constants::numAxis; i++) {
+            pos[i] = getCurrentPosition(i);
+        }
+        _path.clear();
+        _path.setStartPosition(pos);
+    }
+    for (int i=0; i<constants::numAxis; i++) {
+        pos[i] = target[i];
+    }
+    if (!_path.addSegment(pos,nominalRate)) {
+        return false;
+    }
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        if (!_pathActive && !_stopLatched && !_path.isEmpty()) {
+            _pathActive = true;
+            _pathBlockLoaded = false;
+            _pathRate = _pathMinRate;
+            _pathPeriod = (long) (1.0e6/_pathRate);
+            _pathTime = 0;
+            setTimerPeriod(_pathPeriod);
+        }
+    }
+    return true;
+}
+
+uint8_t MotorDrive::getPathFree() {
+    return _path.getFree();
+}
+
+bool MotorDrive::isPathActive() {
+    return _pathActive;
+}
+
+void MotorDrive::updatePathRate() {
+    // Called from the step timer interrupt at the acceleration tick rate. 
+    // Accelerates towards the segment's nominal rate while making sure the
+    // remaining steps, less those taken before the next update, are enough 
+    // to slow down to the segment's exit rate.
+    PathBlock *block = _path.getCurrentBlock();
+    float dt = constants::pathAccelTickPeriod*1.0e-6;
+    float accel = _path.getAcceleration();
+    float exitRate;
+    float remaining;
+    float rate;
+    if (block == 0) {
+        return;
+    }
+    exitRate = block->exitRate;
+    remaining = block->stepCount - _pathTicks - _pathRate*dt;
+    if (remaining < 0) {
+        remaining = 0;
+    }
+    rate = sqrt(exitRate*exitRate + 2.0*accel*remaining);
+    rate = min(rate, block->nominalRate*_feedPercent*0.01);
+    rate = min(rate, 1.0e6/_minPeriod);
+    if (_pathRate < rate) {
+        _pathRate = min(_pathRate + accel*dt, rate);
+    }
+    else {
+        _pathRate = rate;
+    }
+    _pathRate = max(_pathRate, _pathMinRate);
+    _pathPeriod = max((long) (1.0e6/_pathRate), _minPeriod);
+    setTimerPeriod(_pathPeriod);
+}
+
+void MotorDrive::endPath() {
+    // Should be called in an atomic block. Returns the axes to the default 
+    // rate and the timer to the set period.
+    for (int i=0; i<constants::numAxis; i++) {
+        loadRate(i,1,1);
+    }
+    _pathActive = false;
+    _pathBlockLoaded = false;
+    setTimerPeriod(getScaledPeriod());
+}
+
+void MotorDrive::clearPath() {
+    // Should be called in an atomic block
+    _path.clear();
+    if (_pathActive) {
+        endPath();
+    }
+}
@@ -1,9 +1,20 @@
 #ifndef _MOTOR_DRIVE_H_
 #define _MOTOR_DRIVE_H_
 #include "Stepper.h"
+#include "CurveGen.h"
+#include "PathPlanner.h"
+#include "CaptureBuffer.h"
+#include "CompareTable.h"
 #include "Array.h"
 #include "constants.h"
 
+// Consistent sample of the step state, published by the timer interrupt.
+struct DriveSnapshot {
+    long position[constants::numAxis];  // Steps
+    uint8_t runningMask;                // Bit i set if axis i is running
+    unsigned long tick;                 // Timer interrupt count
+};
+
 class MotorDrive {
     public:
         MotorDrive();
@@ -17,7 +28,10 @@ class MotorDrive {
         bool isEnabled();
 #endif
         bool isPowerOn();
+        bool isReady();
+        bool checkReadyEvent();
         bool isRunning();
+        bool isAxisRunning(unsigned int i);
 
         void setPowerOn();
         void setPowerOff();
@@ -25,46 +39,100 @@ class MotorDrive {
         void stop(unsigned int i);
         void start(unsigned int i);
         void stopAll();
+        void emergencyStop();
+        bool isStopLatched();
+        void releaseStop();
         void startAll();
+        void armAll();
+        bool startArmed();
+        bool isArmed();
+        void cancelArmed();
+        void triggerAction();
+        long getTriggerIsrTime();
+
+        bool isFault();
+        bool isFaultInputActive();
+        bool checkFaultEvent();
+        bool clearFault();
+        unsigned long getFaultTime();
+        uint8_t getFaultAxisMask();
+        void getFaultPositionAll(Array<long, constants::numAxis> &pos);
 
         void home(unsigned int i);
         void homeAll();
 
         void setSpeed(unsigned int v);
+        void setPeriod(long period);
+        void setMinPeriod(long period);
+
+        void setFeedOverride(uint8_t percent);
+        uint8_t getFeedOverride();
+        uint8_t getFeedOverrideTarget();
+
+        void setRate(unsigned int i, long num, long den);
+        void setRateAll(const Array<long, constants::numAxis> &num, long den);
+        void setRateAllToDefault();
 
         void setDirection(unsigned int i, char dir);
-        void setDirectionAll(Array<char, constants::numAxis> dir);
+        void setDirectionAll(const Array<char, constants::numAxis> &dir);
 
         void setTargetPosition(unsigned int i, long pos);
-        void setTargetPositionAll(Array<long, constants::numAxis> pos);
+        void setTargetPositionAll(const Array<long, constants::numAxis> &pos);
 
         long getCurrentPosition(unsigned int i);
-        Array<long, constants::numAxis> getCurrentPositionAll();
+        void getCurrentPositionAll(Array<long, constants::numAxis> &pos);
+        void getSnapshot(DriveSnapshot &snapshot);
         void setCurrentPosition(unsigned int i, long pos);
-        void setCurrentPositionAll(Array<long, constants::numAxis> pos);
+        void setCurrentPositionAll(const Array<long, constants::numAxis> &pos);
 
         void setHomePosition(unsigned int i, long pos);
-        void setHomePositionAll(Array<long, constants::numAxis> pos);
+        void setHomePositionAll(const Array<long, constants::numAxis> &pos);
         long getHomePosition(unsigned int i);
-        Array<long, constants::numAxis> getHomePositionAll();
+        void getHomePositionAll(Array<long, constants::numAxis> &pos);
 
         bool isHome(unsigned int i);
         bool isHomeAll();
+        bool isPositionKnownAll();
+        void setPositionKnownAll(bool known);
 
         void setHomeSearchDir(unsigned int i, char dir);
-        void setHomeSearchDirAll(Array<char, constants::numAxis> dir);
+        void setHomeSearchDirAll(const Array<char, constants::numAxis> &dir);
         char getHomeSearchDir(unsigned int i);
-        Array<char, constants::numAxis> getHomeSearchDir();
+        void getHomeSearchDirAll(Array<char, constants::numAxis> &dir);
 
         void setHomeSearchDist(unsigned int i, long dist);
-        void setHomeSearchDistAll(Array<long, constants::numAxis> dist);
+        void setHomeSearchDistAll(const Array<long, constants::numAxis> &dist);
         long getHomeSearchDist(unsigned int i);
-        Array<long, constants::numAxis> getHomeSearchDist();
+        void getHomeSearchDistAll(Array<long, constants::numAxis> &dist);
 
         void homeAction(unsigned int i);
 
+        bool getCapture(unsigned int i, PositionCapture &capture);
+        uint16_t getCaptureLost(unsigned int i);
+
+        void setCompareOutput(int pin, unsigned int pulseWidth);
+        bool loadCompareTable(unsigned int i, const long *pos, uint8_t num);
+        bool setCompareInterval(unsigned int i, long interval);
+        bool armCompare();
+        void clearCompare();
+        bool isCompareArmed();
+        unsigned long getComparePulseCount();
+
+        void startCurve(unsigned int h, CurveGen &curve);
+        void stopCurve(unsigned int h);
+        bool isCurveActive(unsigned int h);
+
+        void setPathParams(float accel, float deviation, float minRate);
+        bool addPathSegment(const Array<long, constants::numAxis> &target, float nominalRate);
+        uint8_t getPathFree();
+        bool isPathActive();
+
     private:
         Array<Stepper,constants::numAxis> _stepper;
+        CurveGen _curve[constants::numHerder];
+        PathPlanner _path;
+        CaptureBuffer _capture[constants::numAxis];
+        CompareTable _compare[constants::numAxis];
         int _powerPin;
 #ifdef HAVE_ENABLE
         int _disablePin;
@@ -72,18 +140,409 @@ class MotorDrive {
         int _faultPin;
         bool _powerOnFlag;
         bool _enabledFlag;
+
+        // Set by the timer interrupt once the drive power has settled and the 
+        // fault input is clear. No steps are made, and the fault input is not
+        // watched, until then.
+        volatile bool _readyFlag;
+        volatile bool _readyEvent;
+        unsigned long _powerOnTime;
+        long _period;
+        long _timerPeriod;
+        long _minPeriod;    // Timer period (us) at constants::maxSpeed
+
+        // Feed override (%) - scales the step rate of all moves. Set from 
+        // the serial receive interrupt and ramped towards the target by the 
+        // timer interrupt.
+        volatile uint8_t _feedTarget;
+        volatile uint8_t _feedPercent;
+        long _feedTime;
+
+        // Per axis step state used by the timer interrupt. Kept in parallel
+        // arrays, with the running/homing/inverted flags as bit masks (bit i 
+        // for axis i), so that the interrupt indexes plain arrays and can 
+        // test all axes with a single byte compare.
+        volatile long _currentPos[constants::numAxis];  // Steps
+        volatile long _targetPos[constants::numAxis];   // Steps
+        volatile long _rateNum[constants::numAxis];     // Steps per _rateDen ticks
+        volatile long _rateDen[constants::numAxis];
+        volatile long _rateAccum[constants::numAxis];
+        volatile uint8_t *_stepPortReg[constants::numAxis];
+        volatile uint8_t *_dirPortReg[constants::numAxis];
+        uint8_t _stepBitMask[constants::numAxis];
+        uint8_t _dirBitMask[constants::numAxis];
+        volatile uint8_t _runningMask;
+        volatile uint8_t _homingMask;
+        volatile uint8_t _armedMask;     // Loaded but held until startArmed
+        volatile uint8_t _knownMask;     // Homed or set since reset or fault
+
+        // Time (us) the trigger interrupt spent from its entry to the first
+        // step, recorded by the trigger interrupt itself. It does not include
+        // the time from the input edge to the interrupt entry.
+        volatile bool _triggerPending;
+        unsigned long _triggerTime;
+        volatile long _triggerIsrTime;
+
+        // Compare output. The axes in _compareMask check their compare table
+        // on each step and pulse the output pin when an entry is hit. The 
+        // pulse ends on the first timer tick at least _comparePulseWidth us 
+        // after it started, or with the step pulses when the width is 0.
+        volatile uint8_t _compareMask;
+        volatile uint8_t *_comparePortReg;
+        uint8_t _compareBitMask;
+        unsigned int _comparePulseWidth;
+        volatile bool _comparePulseActive;
+        unsigned long _comparePulseStart;
+        volatile unsigned long _comparePulseCount;
+        volatile uint8_t _dirInvertedMask;
+        volatile uint8_t _stepInvertedMask;
+
+        // Double buffered snapshot of the positions, running axes and tick
+        // count. The writer, the timer interrupt or code in an atomic block,
+        // fills the buffer not in use and then increments _snapshotSeq, whose
+        // low bit selects the current buffer. Readers copy the current buffer
+        // and retry if the sequence has changed, so they never disable 
+        // interrupts.
+        volatile long _snapshotPos[2][constants::numAxis];
+        volatile uint8_t _snapshotRunning[2];
+        volatile unsigned long _snapshotTick[2];
+        volatile uint8_t _snapshotSeq;
+        unsigned long _tickCount;
+
+        // Drive fault input, polled by the timer interrupt. The fault latches
+        // the time, the running axes and the axis positions.
+        volatile uint8_t *_faultPortReg;
+        uint8_t _faultBitMask;
+        uint8_t _faultActiveBits;
+        volatile bool _faultFlag;
+        volatile bool _faultEvent;
+        unsigned long _faultTime;
+        uint8_t _faultAxisMask;
+        long _faultPos[constants::numAxis];
+
+        // Set by an emergency stop and held until the stop has been reported.
+        // Motion is only started, in the atomic block that starts it, while
+        // it is clear, so a move already being loaded when the stop arrives
+        // does not start afterwards.
+        volatile bool _stopLatched;
+
+        volatile bool _pathActive;
+        bool _pathBlockLoaded;
+        float _pathRate;           // steps/s of the dominant axis
+        float _pathMinRate;
+        long _pathPeriod;
+        long _pathTicks;
+        long _pathTime;
+
+        void startAxis(uint8_t i);
+        void homeAxis(uint8_t i);
+        void latchFault();
+        void updateSteps();
+        void publishSnapshot();
+        void startComparePulse();
+        void updateComparePulse();
+        bool checkReady();
+        void setTimerPeriod(long period);
+        long getScaledPeriod();
+        void updateFeed();
+        void loadRate(uint8_t i, long num, long den);
+        void updateCurve(uint8_t h);
+        void clearCurve(uint8_t h);
+        void updatePath();
+        void updatePathRate();
+        void endPath();
+        void clearPath();
 };
 
 
+inline void MotorDrive::startAxis(uint8_t i) {
+    // Should be called in an atomic block
+    _rateAccum[i] = 0;
+    _runningMask |= (1 << i);
+}
+
+inline bool MotorDrive::startArmed() {
+    // Starts the armed axes. Should be called in an atomic block - it is 
+    // called from the serial receive interrupt so that several devices can be
+    // started together. Returns false if no axes were armed.
+    uint8_t armed = _armedMask;
+    if (armed == 0) {
+        return false;
+    }
+    for (uint8_t i=0; i<constants::numAxis; i++) {
+        if (armed & (1 << i)) {
+            startAxis(i);
+        }
+    }
+    _armedMask = 0;
+    return true;
+}
+
+inline void MotorDrive::triggerAction() {
+    // Called from the trigger input interrupt. Starts the armed axes with 
+    // their rate accumulators preloaded and runs the step update at once, so
+    // the first step is made now rather than on the next timer tick. The 
+    // first step interval may therefore be short by up to one timer period.
+    uint8_t armed = _armedMask;
+    unsigned long t = micros();
+    if (!startArmed()) {
+        return;
+    }
+    for (uint8_t i=0; i<constants::numAxis; i++) {
+        if (armed & (1 << i)) {
+            _rateAccum[i] = _rateDen[i] - _rateNum[i];
+        }
+    }
+    _triggerTime = t;
+    _triggerPending = true;
+    updateSteps();
+    publishSnapshot();
+}
+
+inline void MotorDrive::startComparePulse() {
+    *_comparePortReg |= _compareBitMask;
+    _comparePulseActive = true;
+    _comparePulseStart = micros();
+    _comparePulseCount++;
+}
+
+inline void MotorDrive::updateComparePulse() {
+    if ((micros() - _comparePulseStart) >= _comparePulseWidth) {
+        *_comparePortReg &= ~_compareBitMask;
+        _comparePulseActive = false;
+    }
+}
+
+inline void MotorDrive::loadRate(uint8_t i, long num, long den) {
+    // Should be called in an atomic block
+    if ((num < 0) || (den <= 0) || (num > den)) {
+        return;
+    }
+    _rateNum[i] = num;
+    _rateDen[i] = den;
+    _rateAccum[i] = 0;
+}
+
+inline long MotorDrive::getScaledPeriod() {
+    // Set period scaled by the feed override, but no shorter than the period
+    // at max speed.
+    long period = (_period*100)/_feedPercent;
+    return max(period, _minPeriod);
+}
+
+inline void MotorDrive::updateFeed() {
+    // Ramps the feed override towards its target, feedOverrideRampStep 
+    // percent every acceleration tick period, so that rate changes are
+    // gradual. While a path is running the path applies the override at its 
+    // next rate update.
+    _feedTime += _timerPeriod;
+    if (_feedTime < constants::pathAccelTickPeriod) {
+        return;
+    }
+    _feedTime = 0;
+    if (_feedPercent < _feedTarget) {
+        _feedPercent = min(_feedPercent + constants::feedOverrideRampStep, _feedTarget);
+    }
+    else {
+        _feedPercent = max(_feedPercent - constants::feedOverrideRampStep, _feedTarget);
+    }
+    if (!_pathActive) {
+        setTimerPeriod(getScaledPeriod());
+    }
+}
+
+inline void MotorDrive::updateCurve(uint8_t h) {
+    // Loads the next chord of the herder's curve once both of its axes have 
+    // reached the end of the previous one. The axis rates are set so that 
+    // both axes arrive at the end of the chord together.
+    uint8_t ix = h*constants::numDim;
+    uint8_t iy = ix + 1;
+    long x;
+    long y;
+    long dx;
+    long dy;
+    if (_runningMask & ((1 << ix) | (1 << iy))) {
+        return;
+    }
+    while (_curve[h].next(x,y)) {
+        dx = labs(x - _currentPos[ix]);
+        dy = labs(y - _currentPos[iy]);
+        if ((dx > 0) || (dy > 0)) {
+            loadRate(ix, dx, max(dx,dy));
+            loadRate(iy, dy, max(dx,dy));
+            _targetPos[ix] = x;
+            _targetPos[iy] = y;
+            startAxis(ix);
+            startAxis(iy);
+            return;
+        }
+    }
+    loadRate(ix,1,1);
+    loadRate(iy,1,1);
+}
+
+inline void MotorDrive::updatePath() {
+    // Loads the next path segment once all axes have reached the end of the
+    // previous one. The rate is adjusted at the acceleration tick rate.
+    PathBlock *block;
+    if (_runningMask == 0) {
+        if (_pathBlockLoaded) {
+            _path.discardCurrentBlock();
+            _pathBlockLoaded = false;
+        }
+        block = _path.getCurrentBlock();
+        if (block == 0) {
+            endPath();
+            return;
+        }
+        for (uint8_t i=0; i<constants::numAxis; i++) {
+            loadRate(i, labs(block->delta[i]), block->stepCount);
+            _targetPos[i] = block->target[i];
+            startAxis(i);
+        }
+        _pathBlockLoaded = true;
+        _pathTicks = 0;
+    }
+    _pathTicks++;
+    _pathTime += _pathPeriod;
+    if (_pathTime >= constants::pathAccelTickPeriod) {
+        _pathTime = 0;
+        updatePathRate();
+    }
+}
+
+inline void MotorDrive::publishSnapshot() {
+    // Should be called in an atomic block, e.g. from an interrupt.
+    uint8_t j = (_snapshotSeq + 1) & 1;
+    for (uint8_t i=0; i<constants::numAxis; i++) {
+        _snapshotPos[j][i] = _currentPos[i];
+    }
+    _snapshotRunning[j] = _runningMask;
+    _snapshotTick[j] = _tickCount;
+    _snapshotSeq++;
+}
+
 inline void MotorDrive::update() {
-    if (_enabledFlag && _powerOnFlag) {
-        for (int i=0; i<constants::numAxis; i++) {
-            _stepper[i].updateDirPin();
-            _stepper[i].setStepPinHigh();
+    _tickCount++;
+    updateSteps();
+    publishSnapshot();
+}
+
+inline void MotorDrive::updateSteps() {
+    uint8_t running;
+    uint8_t stepMask = 0;
+    bool compareFire = false;
+    if (_comparePulseActive) {
+        updateComparePulse();
+    }
+    if (!(_enabledFlag && _powerOnFlag)) {
+        return;
+    }
+    if (!_readyFlag && !checkReady()) {
+        return;
+    }
+    if (_faultFlag) {
+        return;
+    }
+    if ((*_faultPortReg & _faultBitMask) == _faultActiveBits) {
+        latchFault();
+        return;
+    }
+    if (_feedPercent != _feedTarget) {
+        updateFeed();
+    }
+    if (_pathActive) {
+        updatePath();
+    }
+    for (uint8_t h=0; h<constants::numHerder; h++) {
+        if (_curve[h].isActive()) {
+            updateCurve(h);
+        }
+    }
+    running = _runningMask;
+    if (running == 0) {
+        return;
+    }
+
+    // Bresenham style rate divider - each axis steps _rateNum times every 
+    // _rateDen timer ticks. Sets the direction pins and the step pins of the
+    // axes which are due to step.
+    for (uint8_t i=0; i<constants::numAxis; i++) {
+        uint8_t bit = 1 << i;
+        if (!(running & bit)) {
+            continue;
+        }
+        _rateAccum[i] += _rateNum[i];
+        if (_rateAccum[i] < _rateDen[i]) {
+            continue;
+        }
+        _rateAccum[i] -= _rateDen[i];
+        if (_currentPos[i] < _targetPos[i]) {
+            if (_dirInvertedMask & bit) {
+                *_dirPortReg[i] &= ~_dirBitMask[i];
+            }
+            else {
+                *_dirPortReg[i] |= _dirBitMask[i];
+            }
+            _currentPos[i] += 1;
+            if ((_compareMask & bit) && _compare[i].stepUp(_currentPos[i])) {
+                compareFire = true;
+            }
         }
-        for (int i=0; i<constants::numAxis; i++) {
-            _stepper[i].setStepPinLow();
+        else if (_currentPos[i] > _targetPos[i]) {
+            if (_dirInvertedMask & bit) {
+                *_dirPortReg[i] |= _dirBitMask[i];
+            }
+            else {
+                *_dirPortReg[i] &= ~_dirBitMask[i];
+            }
+            _currentPos[i] -= 1;
+            if ((_compareMask & bit) && _compare[i].stepDown(_currentPos[i])) {
+                compareFire = true;
+            }
         }
+        else {
+            continue;
+        }
+        stepMask |= bit;
+        if (_stepInvertedMask & bit) {
+            *_stepPortReg[i] &= ~_stepBitMask[i];
+        }
+        else {
+            *_stepPortReg[i] |= _stepBitMask[i];
+        }
+    }
+    if (compareFire) {
+        startComparePulse();
+    }
+    if (_triggerPending && stepMask) {
+        // Only set by triggerAction, which calls this from the trigger 
+        // interrupt, so this is the time taken by that interrupt so far.
+        _triggerIsrTime = micros() - _triggerTime;
+        _triggerPending = false;
+    }
+
+    // End the step pulses and stop the axes which have reached their targets
+    for (uint8_t i=0; i<constants::numAxis; i++) {
+        uint8_t bit = 1 << i;
+        if (!(running & bit)) {
+            continue;
+        }
+        if (stepMask & bit) {
+            if (_stepInvertedMask & bit) {
+                *_stepPortReg[i] |= _stepBitMask[i];
+            }
+            else {
+                *_stepPortReg[i] &= ~_stepBitMask[i];
+            }
+        }
+        if (_currentPos[i] == _targetPos[i]) {
+            _runningMask &= ~bit;
+            _homingMask &= ~bit;
+        }
+    }
+    if (compareFire && (_comparePulseWidth == 0)) {
+        updateComparePulse();
     }
 }
 
@@ -0,0 +1,172 @@
+#include <util/atomic.h>
+#if defined(ARDUINO) && ARDUINO >= 100
+#include "Arduino.h"
+#else
+#include "WProgram.h"
+#endif
+#include "PathPlanner.h"
+
+PathPlanner::PathPlanner() {
+    _accel = 0.0;
+    _deviation = 0.0;
+    for (int i=0; i<constants::numAxis; i++) {
+        _endPos[i] = 0;
+    }
+    clear();
+}
+
+void PathPlanner::clear() {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        _head = 0;
+        _tail = 0;
+        _count = 0;
+    }
+}
+
+void PathPlanner::setStartPosition(long pos[]) {
+    // Sets the start position of the next segment. Should only be called when
+    // the buffer is empty.
+    for (int i=0; i<constants::numAxis; i++) {
+        _endPos[i] = pos[i];
+    }
+}
+
+bool PathPlanner::addSegment(long target[], float nominalRate) {
+    // Appends a segment from the end of the previous segment to the target
+    // position. Returns false if the buffer is full.
+    PathBlock &block = _block[_head];
+    long stepCount = 0;
+    if (isFull()) {
+        return false;
+    }
+    for (int i=0; i<constants::numAxis; i++) {
+        block.target[i] = target[i];
+        block.delta[i] = target[i] - _endPos[i];
+        stepCount = max(stepCount, labs(block.delta[i]));
+    }
+    if (stepCount == 0) {
+        return true;
+    }
+    block.stepCount = stepCount;
+    block.nominalRate = nominalRate;
+    block.exitRate = 0.0;
+    if (isEmpty()) {
+        block.maxEntryRate = 0.0;
+    }
+    else {
+        PathBlock &prev = _block[prevIndex(_head)];
+        block.maxEntryRate = junctionRate(prev,block);
+        block.maxEntryRate = min(block.maxEntryRate, block.nominalRate);
+        block.maxEntryRate = min(block.maxEntryRate, prev.nominalRate);
+    }
+    for (int i=0; i<constants::numAxis; i++) {
+        _endPos[i] = target[i];
+    }
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        _head = nextIndex(_head);
+        _count++;
+    }
+    replan();
+    return true;
+}
+
+void PathPlanner::setAcceleration(float accel) {
+    _accel = accel;
+}
+
+float PathPlanner::getAcceleration() {
+    return _accel;
+}
+
+void PathPlanner::setJunctionDeviation(float deviation) {
+    _deviation = deviation;
+}
+
+float PathPlanner::getJunctionDeviation() {
+    return _deviation;
+}
+
+bool PathPlanner::isFull() {
+    return _count >= constants::pathBufferSize;
+}
+
+uint8_t PathPlanner::getFree() {
+    return constants::pathBufferSize - _count;
+}
+
+float PathPlanner::junctionRate(PathBlock &prev, PathBlock &next) {
+    // Maximum rate through the corner between two segments. For each herder
+    // the herder's speed is limited so that a circle tangent to both segments
+    // stays within the junction deviation of the corner while the centripetal
+    // acceleration is within the acceleration limit.
+    float rate = next.nominalRate;
+    for (int h=0; h<constants::numHerder; h++) {
+        int ix = h*constants::numDim;
+        float px = (float) prev.delta[ix];
+        float py = (float) prev.delta[ix+1];
+        float nx = (float) next.delta[ix];
+        float ny = (float) next.delta[ix+1];
+        float prevLen = sqrt(px*px + py*py);
+        float nextLen = sqrt(nx*nx + ny*ny);
+        float cosTheta;
+        float sinHalf;
+        float herderRate;
+        if ((prevLen == 0.0) && (nextLen == 0.0)) {
+            continue;
+        }
+        if ((prevLen == 0.0) || (nextLen == 0.0)) {
+            // Herder starts or stops at the junction
+            return 0.0;
+        }
+        cosTheta = -(px*nx + py*ny)/(prevLen*nextLen);
+        if (cosTheta < -0.999999) {
+            // Straight through
+            continue;
+        }
+        if (cosTheta > 0.999999) {
+            // Reversal
+            return 0.0;
+        }
+        sinHalf = sqrt(0.5*(1.0 - cosTheta));
+        herderRate = sqrt(_accel*_deviation*sinHalf/(1.0 - sinHalf));
+
+        // Convert the herder's speed to the rate of the dominant axis
+        herderRate *= min(prev.stepCount/prevLen, next.stepCount/nextLen);
+        rate = min(rate, herderRate);
+    }
+    return rate;
+}
+
+void PathPlanner::replan() {
+    // Backward pass over the buffer. The last segment always ends at rest and
+    // every earlier segment exits no faster than the next one can be entered
+    // and still decelerate to its own exit rate.
+    float exitRate[constants::pathBufferSize];
+    uint8_t index;
+    uint8_t count;
+    float rate = 0.0;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        index = prevIndex(_head);
+        count = _count;
+    }
+    if (count == 0) {
+        return;
+    }
+    exitRate[index] = 0.0;
+    for (uint8_t i=1; i<count; i++) {
+        PathBlock &block = _block[index];
+        rate = sqrt(exitRate[index]*exitRate[index] + 2.0*_accel*block.stepCount);
+        rate = min(rate, block.maxEntryRate);
+        index = prevIndex(index);
+        exitRate[index] = rate;
+    }
+
+    index = prevIndex(_head);
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        for (uint8_t i=0; i<count; i++) {
+            _block[index].exitRate = exitRate[index];
+            index = prevIndex(index);
+        }
+    }
+}
@@ -0,0 +1,89 @@
+// PathPlanner.h
+#ifndef _PATH_PLANNER_H_
+#define _PATH_PLANNER_H_
+
+#include <stdint.h>
+#include "constants.h"
+
+// A single straight segment of a continuous path. Positions and rates are in
+// steps and in steps/s of the segment's dominant axis.
+struct PathBlock {
+    long target[constants::numAxis];
+    long delta[constants::numAxis];
+    long stepCount;
+    float nominalRate;
+    float maxEntryRate;
+    volatile float exitRate;
+};
+
+// Look-ahead planner for continuous multi-segment paths. Segments are added
+// from the main loop and consumed from the step timer interrupt. The junction
+// rate between segments is set by the corner angle of each herder and the
+// allowed path deviation. A backward pass limits the exit rate of each segment
+// so that the path can always decelerate to a stop at the end of the buffer.
+class PathPlanner {
+
+    public:
+        PathPlanner();
+
+        void clear();
+        bool addSegment(long target[], float nominalRate);
+        void setStartPosition(long pos[]);
+
+        void setAcceleration(float accel);
+        float getAcceleration();
+        void setJunctionDeviation(float deviation);
+        float getJunctionDeviation();
+
+        bool isEmpty();
+        bool isFull();
+        uint8_t getFree();
+
+        PathBlock *getCurrentBlock();
+        void discardCurrentBlock();
+
+    private:
+        PathBlock _block[constants::pathBufferSize];
+        volatile uint8_t _head;
+        volatile uint8_t _tail;
+        volatile uint8_t _count;
+
+        long _endPos[constants::numAxis];
+        float _accel;             // steps/s^2
+        float _deviation;         // steps
+
+        float junctionRate(PathBlock &prev, PathBlock &next);
+        void replan();
+        uint8_t nextIndex(uint8_t i);
+        uint8_t prevIndex(uint8_t i);
+};
+
+inline uint8_t PathPlanner::nextIndex(uint8_t i) {
+    return (i + 1) % constants::pathBufferSize;
+}
+
+inline uint8_t PathPlanner::prevIndex(uint8_t i) {
+    return (i + constants::pathBufferSize - 1) % constants::pathBufferSize;
+}
+
+inline bool PathPlanner::isEmpty() {
+    return _count == 0;
+}
+
+inline PathBlock *PathPlanner::getCurrentBlock() {
+    // Should be called from the step timer interrupt
+    if (_count == 0) {
+        return 0;
+    }
+    return &_block[_tail];
+}
+
+inline void PathPlanner::discardCurrentBlock() {
+    // Should be called from the step timer interrupt
+    if (_count > 0) {
+        _tail = nextIndex(_tail);
+        _count--;
+    }
+}
+
+#endif
@@ -0,0 +1,143 @@
+#include <stddef.h>
+#include <avr/eeprom.h>
+#include <util/crc16.h>
+#if defined(ARDUINO) && ARDUINO >= 100
+#include "Arduino.h"
+#else
+#include "WProgram.h"
+#endif
+#include "PositionStore.h"
+
+enum {
+    RECORD_MAGIC=0x5a,
+    RECORD_AT_REST=0xa5,
+    RECORD_MOVING=0x00,
+};
+
+PositionStore::PositionStore() {
+    _slot = 0;
+    _count = 0;
+    _loaded = false;
+    _atRest = false;
+    for (int i=0; i<constants::numAxis; i++) {
+        _position[i] = 0;
+    }
+    _writeIndex = sizeof(PositionRecord);
+}
+
+bool PositionStore::initialize() {
+    // Finds the newest valid record in the ring. Returns false if there is
+    // none, e.g. the EEPROM has never been written.
+    PositionRecord record;
+    _loaded = false;
+    for (uint8_t slot=0; slot<constants::positionStoreSize; slot++) {
+        eeprom_read_block(&record, slotAddress(slot), sizeof(record));
+        if ((record.magic != RECORD_MAGIC) || (record.crc != recordCrc(record))) {
+            continue;
+        }
+        if (_loaded && ((int16_t) (record.count - _count) <= 0)) {
+            continue;
+        }
+        _loaded = true;
+        _slot = slot;
+        _count = record.count;
+        _atRest = (record.state == RECORD_AT_REST);
+        for (int i=0; i<constants::numAxis; i++) {
+            _position[i] = record.position[i];
+        }
+    }
+    return _loaded;
+}
+
+bool PositionStore::isLoaded() {
+    return _loaded;
+}
+
+bool PositionStore::isStale() {
+    // True if the newest record was marked as in motion, so the axes may
+    // not have been at its position when the controller was last reset.
+    return !_atRest;
+}
+
+void PositionStore::getPosition(long position[]) {
+    for (int i=0; i<constants::numAxis; i++) {
+        position[i] = _position[i];
+    }
+}
+
+uint16_t PositionStore::getCount() {
+    return _count;
+}
+
+void PositionStore::save(const long position[]) {
+    // Starts writing a new record unless the newest already holds this 
+    // position at rest, so calling it repeatedly while the axes are idle 
+    // costs nothing. Does nothing while the last record is being written.
+    bool same = _loaded && _atRest;
+    if (isBusy()) {
+        return;
+    }
+    for (int i=0; i<constants::numAxis; i++) {
+        same = same && (position[i] == _position[i]);
+    }
+    if (same) {
+        return;
+    }
+    if (_loaded) {
+        _slot = (_slot + 1) % constants::positionStoreSize;
+        _count++;
+    }
+    _record.magic = RECORD_MAGIC;
+    _record.count = _count;
+    for (int i=0; i<constants::numAxis; i++) {
+        _record.position[i] = position[i];
+        _position[i] = position[i];
+    }
+    _record.crc = recordCrc(_record);
+    _record.state = RECORD_AT_REST;
+    _writeIndex = 0;
+    _loaded = true;
+    _atRest = true;
+}
+
+void PositionStore::markMoving() {
+    // The state byte is the last one written, so if the record is still 
+    // being written it is simply written as in motion.
+    if (!_loaded || !_atRest) {
+        return;
+    }
+    _record.state = RECORD_MOVING;
+    if (_writeIndex > offsetof(PositionRecord, state)) {
+        _writeIndex = offsetof(PositionRecord, state);
+    }
+    _atRest = false;
+}
+
+void PositionStore::update() {
+    // Writes the staged bytes, stopping as soon as a write is in progress.
+    // Bytes which already hold their value are skipped without a write.
+    const uint8_t *data = (const uint8_t *) &_record;
+    uint8_t *addr = (uint8_t *) slotAddress(_slot);
+    while ((_writeIndex < sizeof(PositionRecord)) && eeprom_is_ready()) {
+        eeprom_update_byte(addr + _writeIndex, data[_writeIndex]);
+        _writeIndex++;
+    }
+}
+
+bool PositionStore::isBusy() {
+    return _writeIndex < sizeof(PositionRecord);
+}
+
+PositionRecord *PositionStore::slotAddress(uint8_t slot) {
+    return (PositionRecord *) (constants::positionStoreAddress + slot*sizeof(PositionRecord));
+}
+
+uint8_t PositionStore::recordCrc(const PositionRecord &record) {
+    // CRC-8 of the record up to, but not including, the crc field
+    const uint8_t *data = (const uint8_t *) &record;
+    uint8_t crc = 0;
+    for (size_t i=0; i<offsetof(PositionRecord, crc); i++) {
+        crc = _crc8_ccitt_update(crc, data[i]);
+    }
+    return crc;
+}
@@ -0,0 +1,61 @@
+// PositionStore.h
+#ifndef _POSITION_STORE_H_
+#define _POSITION_STORE_H_
+
+#include <stdint.h>
+#include "constants.h"
+
+// One saved set of axis positions. The record with the highest count is the
+// newest. The state byte is outside the CRC so that it can be rewritten on
+// its own.
+struct PositionRecord {
+    uint8_t magic;
+    uint16_t count;
+    long position[constants::numAxis];  // Steps
+    uint8_t crc;
+    uint8_t state;
+};
+
+// Axis positions saved to EEPROM so that they survive a reset or power cycle.
+//
+// Records are written in turn round a ring of constants::positionStoreSize
+// slots, each to the slot after the newest, to spread the wear over the
+// ring. A record is written when the axes come to rest at a new position,
+// and is marked as in motion - by rewriting its state byte only - when they
+// next start moving. A record still marked as in motion when it is loaded
+// may be out of date, e.g. power was lost part way through a move.
+//
+// save and markMoving only stage the bytes to write. update, called from the
+// main loop, writes them a byte at a time whenever the EEPROM is ready, so
+// the caller never waits the 3.3 ms each byte takes. A record cut short by a
+// reset fails its CRC and the one before it is used.
+class PositionStore {
+
+    public:
+        PositionStore();
+
+        bool initialize();
+        bool isLoaded();
+        bool isStale();
+        void getPosition(long position[]);
+        uint16_t getCount();
+
+        void save(const long position[]);
+        void markMoving();
+        void update();
+        bool isBusy();
+
+    private:
+        uint8_t _slot;
+        uint16_t _count;
+        bool _loaded;
+        bool _atRest;
+        long _position[constants::numAxis];
+        PositionRecord _record;   // Being written to _slot
+        uint8_t _writeIndex;      // Next byte of _record to write
+
+        PositionRecord *slotAddress(uint8_t slot);
+        uint8_t recordCrc(const PositionRecord &record);
+};
+
+#endif
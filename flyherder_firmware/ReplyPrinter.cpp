@@ -0,0 +1,136 @@
+#if defined(ARDUINO) && ARDUINO >= 100
+#include "Arduino.h"
+#else
+#include "WProgram.h"
+#endif
+#include "ReplyPrinter.h"
+
+ReplyPrinter::ReplyPrinter(Print &port) : _port(port) {
+    _first = true;
+}
+
+void ReplyPrinter::start() {
+    _port.print('{');
+    _first = true;
+}
+
+void ReplyPrinter::stop() {
+    _port.print('}');
+    _port.println();
+}
+
+void ReplyPrinter::addIntItem(const __FlashStringHelper *key, int value) {
+    addKey(key);
+    _port.print(value);
+}
+
+void ReplyPrinter::addLongItem(const __FlashStringHelper *key, long value) {
+    addKey(key);
+    _port.print(value);
+}
+
+void ReplyPrinter::addFltItem(const __FlashStringHelper *key, float value) {
+    addKey(key);
+    _port.print(value, REPLY_FLT_PRECISION);
+}
+
+void ReplyPrinter::addStrItem(const __FlashStringHelper *key, const char *value) {
+    addKey(key);
+    _port.print('"');
+    _port.print(value);
+    _port.print('"');
+}
+
+void ReplyPrinter::addStrItem(const __FlashStringHelper *key, const __FlashStringHelper *value) {
+    addKey(key);
+    _port.print('"');
+    _port.print(value);
+    _port.print('"');
+}
+
+void ReplyPrinter::addCharItem(const __FlashStringHelper *key, char value) {
+    addKey(key);
+    _port.print('"');
+    _port.print(value);
+    _port.print('"');
+}
+
+void ReplyPrinter::addEmptyItem(const __FlashStringHelper *key) {
+    addKey(key);
+    _port.print('"');
+    _port.print('"');
+}
+
+void ReplyPrinter::addLongListItem(const __FlashStringHelper *key, const long values[], int num) {
+    addKey(key);
+    _port.print('[');
+    for (int i=0; i<num; i++) {
+        if (i > 0) {
+            _port.print(',');
+        }
+        _port.print(values[i]);
+    }
+    _port.print(']');
+}
+
+void ReplyPrinter::addLongListItem(const __FlashStringHelper *key, const unsigned long values[], int num) {
+    addKey(key);
+    _port.print('[');
+    for (int i=0; i<num; i++) {
+        if (i > 0) {
+            _port.print(',');
+        }
+        _port.print(values[i]);
+    }
+    _port.print(']');
+}
+
+void ReplyPrinter::addIntItem(const char *key, int value) {
+    addKey(key);
+    _port.print(value);
+}
+
+void ReplyPrinter::addLongItem(const char *key, long value) {
+    addKey(key);
+    _port.print(value);
+}
+
+void ReplyPrinter::addFltItem(const char *key, float value) {
+    addKey(key);
+    _port.print(value, REPLY_FLT_PRECISION);
+}
+
+void ReplyPrinter::addCharItem(const char *key, char value) {
+    addKey(key);
+    _port.print('"');
+    _port.print(value);
+    _port.print('"');
+}
+
+void ReplyPrinter::addEmptyItem(const char *key) {
+    addKey(key);
+    _port.print('"');
+    _port.print('"');
+}
+
+void ReplyPrinter::addKey(const __FlashStringHelper *key) {
+    startKey();
+    _port.print(key);
+    _port.print('"');
+    _port.print(':');
+}
+
+void ReplyPrinter::addKey(const char *key) {
+    startKey();
+    _port.print(key);
+    _port.print('"');
+    _port.print(':');
+}
+
+void ReplyPrinter::startKey() {
+    if (!_first) {
+        _port.print(',');
+    }
+    _first = false;
+    _port.print('"');
+}
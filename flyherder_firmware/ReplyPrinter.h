@@ -0,0 +1,52 @@
+// ReplyPrinter.h
+#ifndef _REPLY_PRINTER_H_
+#define _REPLY_PRINTER_H_
+
+#if defined(ARDUINO) && ARDUINO >= 100
+#include "Arduino.h"
+#else
+#include "WProgram.h"
+#endif
+
+enum {REPLY_FLT_PRECISION=6};
+
+// Writes a reply as a single line json dictionary, {"key":value,...}. Same
+// interface as DictPrinter but prints to any Print object, so that replies
+// can be sent through the serial port's transmit queue.
+//
+// Keys are flash strings, e.g. F("status"), so that they take no SRAM. Keys
+// in SRAM are only taken where they come from a table of names, e.g. 
+// constants::axisNames.
+class ReplyPrinter {
+
+    public:
+        ReplyPrinter(Print &port);
+
+        void start();
+        void stop();
+
+        void addIntItem(const __FlashStringHelper *key, int value);
+        void addLongItem(const __FlashStringHelper *key, long value);
+        void addFltItem(const __FlashStringHelper *key, float value);
+        void addStrItem(const __FlashStringHelper *key, const char *value);
+        void addStrItem(const __FlashStringHelper *key, const __FlashStringHelper *value);
+        void addCharItem(const __FlashStringHelper *key, char value);
+        void addEmptyItem(const __FlashStringHelper *key);
+        void addLongListItem(const __FlashStringHelper *key, const long values[], int num);
+        void addLongListItem(const __FlashStringHelper *key, const unsigned long values[], int num);
+
+        void addIntItem(const char *key, int value);
+        void addLongItem(const char *key, long value);
+        void addFltItem(const char *key, float value);
+        void addCharItem(const char *key, char value);
+        void addEmptyItem(const char *key);
+
+    private:
+        Print &_port;
+        bool _first;
+        void addKey(const __FlashStringHelper *key);
+        void addKey(const char *key);
+        void startKey();
+};
+
+#endif
@@ -0,0 +1,265 @@
+#include <util/atomic.h>
+#if defined(ARDUINO) && ARDUINO >= 100
+#include "Arduino.h"
+#else
+#include "WProgram.h"
+#endif
+#include "SerialPort.h"
+
+SerialPort serialPort;
+
+ISR(USART0_RX_vect) {
+    serialPort.rxInterrupt();
+}
+
+ISR(USART0_UDRE_vect) {
+    serialPort.txInterrupt();
+}
+
+SerialPort::SerialPort() {
+    _rxHead = 0;
+    _rxTail = 0;
+    _rxOverflow = 0;
+    _rxFlushed = false;
+    _rxFastPath = 0;
+    _txHead = 0;
+    _txTail = 0;
+    _txAtLineStart = true;
+    _priHead = 0;
+    _priTail = 0;
+    _priInLine = false;
+    _priWriteHead = 0;
+    _priMode = false;
+    _priOverflow = false;
+    _txHighWater = 0;
+    _txBlocked = 0;
+    _priDropped = 0;
+}
+
+void SerialPort::begin(unsigned long baudrate) {
+    // 8N1 in double speed mode, same baud rate setting as HardwareSerial.
+    uint16_t setting = (F_CPU/4/baudrate - 1)/2;
+    UCSR0A = _BV(U2X0);
+    UBRR0H = setting >> 8;
+    UBRR0L = setting & 0xff;
+    UCSR0C = _BV(UCSZ01) | _BV(UCSZ00);
+    UCSR0B = _BV(RXEN0) | _BV(TXEN0) | _BV(RXCIE0);
+}
+
+int SerialPort::available() {
+    return (SERIAL_RX_BUF_SZ + _rxHead - _rxTail) & (SERIAL_RX_BUF_SZ-1);
+}
+
+int SerialPort::peek() {
+    // Atomic, as flushRx may move the tail from the receive interrupt.
+    int c = -1;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        if (_rxHead != _rxTail) {
+            c = _rxBuf[_rxTail];
+        }
+    }
+    return c;
+}
+
+int SerialPort::read() {
+    int c = -1;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        if (_rxHead != _rxTail) {
+            c = _rxBuf[_rxTail];
+            _rxTail = (_rxTail + 1) & (SERIAL_RX_BUF_SZ-1);
+        }
+    }
+    return c;
+}
+
+void SerialPort::flush() {
+    // Waits until both transmit lanes are empty.
+    while ((txCount() > 0) || (_priHead != _priTail)) {
+    }
+}
+
+#if defined(ARDUINO) && ARDUINO >= 100
+size_t SerialPort::write(uint8_t c) {
+    if (_priMode) {
+        writePriority(c);
+    }
+    else {
+        writeBulk(c);
+    }
+    return 1;
+}
+#else
+void SerialPort::write(uint8_t c) {
+    if (_priMode) {
+        writePriority(c);
+    }
+    else {
+        writeBulk(c);
+    }
+}
+#endif
+
+void SerialPort::setRxFastPath(SerialRxFcn fcn) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        _rxFastPath = fcn;
+    }
+}
+
+void SerialPort::flushRx() {
+    // Discards the received bytes not yet read. May be called from the 
+    // receive fast path. The reader is told by checkRxFlushed, so that it 
+    // can also drop a partly received message.
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        _rxTail = _rxHead;
+        _rxFlushed = true;
+    }
+}
+
+bool SerialPort::checkRxFlushed() {
+    // Returns true, once, after flushRx.
+    bool flag = false;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        flag = _rxFlushed;
+        _rxFlushed = false;
+    }
+    return flag;
+}
+
+void SerialPort::startPriority() {
+    _priMode = true;
+    _priOverflow = false;
+    _priWriteHead = _priHead;
+}
+
+void SerialPort::endPriority() {
+    // Publishes the priority output written since startPriority. Nothing is
+    // sent until here so that the transmit interrupt never starts on a
+    // partial line.
+    _priMode = false;
+    if (_priOverflow) {
+        _priWriteHead = _priHead;
+        if (_priDropped < 0xffff) {
+            _priDropped++;
+        }
+        return;
+    }
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        _priHead = _priWriteHead;
+        enableTxInterrupt();
+    }
+}
+
+uint16_t SerialPort::getTxFree() {
+    return (SERIAL_TX_BUF_SZ-1) - txCount();
+}
+
+void SerialPort::getTxStats(SerialTxStats &stats) {
+    stats.free = getTxFree();
+    stats.highWater = _txHighWater;
+    stats.blocked = _txBlocked;
+    stats.priorityDropped = _priDropped;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        stats.rxOverflow = _rxOverflow;
+    }
+}
+
+void SerialPort::resetTxStats() {
+    _txHighWater = txCount();
+    _txBlocked = 0;
+    _priDropped = 0;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        _rxOverflow = 0;
+    }
+}
+
+void SerialPort::rxInterrupt() {
+    uint8_t c = UDR0;
+    if (_rxFastPath && _rxFastPath(c)) {
+        return;
+    }
+    uint8_t next = (_rxHead + 1) & (SERIAL_RX_BUF_SZ-1);
+    if (next != _rxTail) {
+        _rxBuf[_rxHead] = c;
+        _rxHead = next;
+    }
+    else if (_rxOverflow < 0xffff) {
+        _rxOverflow++;
+    }
+}
+
+void SerialPort::txInterrupt() {
+    // Priority output goes ahead of bulk output, but only between lines.
+    uint8_t c;
+    if ((_priHead != _priTail) && (_priInLine || _txAtLineStart)) {
+        c = _priBuf[_priTail];
+        _priTail = (_priTail + 1) & (SERIAL_TX_PRIORITY_BUF_SZ-1);
+        _priInLine = (c != '\n');
+    }
+    else if (_txHead != _txTail) {
+        c = _txBuf[_txTail];
+        _txTail = (_txTail + 1) & (SERIAL_TX_BUF_SZ-1);
+        _txAtLineStart = (c == '\n');
+    }
+    else {
+        UCSR0B &= ~_BV(UDRIE0);
+        return;
+    }
+    UDR0 = c;
+}
+
+void SerialPort::writeBulk(uint8_t c) {
+    if (txCount() >= SERIAL_TX_BUF_SZ-1) {
+        // Buffer full - wait for the transmit interrupt to make room. With
+        // interrupts disabled the data register is polled instead.
+        if (_txBlocked < 0xffff) {
+            _txBlocked++;
+        }
+        while (txCount() >= SERIAL_TX_BUF_SZ-1) {
+            if (!(SREG & _BV(SREG_I)) && (UCSR0A & _BV(UDRE0))) {
+                txInterrupt();
+            }
+        }
+    }
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        _txBuf[_txHead] = c;
+        _txHead = (_txHead + 1) & (SERIAL_TX_BUF_SZ-1);
+        enableTxInterrupt();
+    }
+    uint16_t count = txCount();
+    if (count > _txHighWater) {
+        _txHighWater = count;
+    }
+}
+
+void SerialPort::writePriority(uint8_t c) {
+    if (_priOverflow) {
+        return;
+    }
+    uint8_t next = (_priWriteHead + 1) & (SERIAL_TX_PRIORITY_BUF_SZ-1);
+    while (next == _priTail) {
+        // Wait for earlier priority lines to drain. If there are none the
+        // line being written does not fit and is dropped in endPriority.
+        if (_priHead == _priTail) {
+            _priOverflow = true;
+            return;
+        }
+        if (!(SREG & _BV(SREG_I)) && (UCSR0A & _BV(UDRE0))) {
+            txInterrupt();
+        }
+    }
+    _priBuf[_priWriteHead] = c;
+    _priWriteHead = next;
+}
+
+void SerialPort::enableTxInterrupt() {
+    // Read-modify-write of UCSR0B, call with interrupts disabled.
+    UCSR0B |= _BV(UDRIE0);
+}
+
+uint16_t SerialPort::txCount() {
+    uint16_t count;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        count = (_txHead - _txTail) & (SERIAL_TX_BUF_SZ-1);
+    }
+    return count;
+}
@@ -0,0 +1,105 @@
+// SerialPort.h
+#ifndef _SERIAL_PORT_H_
+#define _SERIAL_PORT_H_
+
+#include <stdint.h>
+#if defined(ARDUINO) && ARDUINO >= 100
+#include "Arduino.h"
+#else
+#include "WProgram.h"
+#endif
+
+// Buffer sizes must be powers of two.
+enum {
+    SERIAL_RX_BUF_SZ=128,
+    SERIAL_TX_BUF_SZ=1024,
+    SERIAL_TX_PRIORITY_BUF_SZ=64,
+};
+
+// Called from the receive interrupt for each byte. Returns true if the byte
+// has been handled and should not be queued.
+typedef bool (*SerialRxFcn)(uint8_t c);
+
+// Back-pressure counters for the transmit queue.
+struct SerialTxStats {
+    uint16_t free;
+    uint16_t highWater;
+    uint16_t blocked;
+    uint16_t priorityDropped;
+    uint16_t rxOverflow;
+};
+
+// Interrupt driven driver for USART0, used in place of HardwareSerial so that
+// replies are drained from a large ring buffer by the data register empty
+// interrupt and the main loop only waits when that buffer is full.
+//
+// Transmit has two lanes. Bulk output goes through the large buffer. Output
+// written between startPriority() and endPriority() goes through a small
+// priority buffer and is sent ahead of any queued bulk output, at the next
+// line boundary, so that replies are never interleaved. A priority reply must
+// be a whole line shorter than the priority buffer, otherwise it is dropped.
+class SerialPort : public Stream {
+
+    public:
+        SerialPort();
+        void begin(unsigned long baudrate);
+
+        int available();
+        int peek();
+        int read();
+        void flush();
+#if defined(ARDUINO) && ARDUINO >= 100
+        size_t write(uint8_t c);
+#else
+        void write(uint8_t c);
+#endif
+        using Print::write;
+
+        void setRxFastPath(SerialRxFcn fcn);
+        void flushRx();
+        bool checkRxFlushed();
+
+        void startPriority();
+        void endPriority();
+
+        uint16_t getTxFree();
+        void getTxStats(SerialTxStats &stats);
+        void resetTxStats();
+
+        void rxInterrupt();
+        void txInterrupt();
+
+    private:
+        volatile uint8_t _rxBuf[SERIAL_RX_BUF_SZ];
+        volatile uint8_t _rxHead;
+        volatile uint8_t _rxTail;
+        volatile uint16_t _rxOverflow;
+        volatile bool _rxFlushed;
+        SerialRxFcn _rxFastPath;
+
+        volatile uint8_t _txBuf[SERIAL_TX_BUF_SZ];
+        volatile uint16_t _txHead;
+        volatile uint16_t _txTail;
+        volatile bool _txAtLineStart;
+
+        volatile uint8_t _priBuf[SERIAL_TX_PRIORITY_BUF_SZ];
+        volatile uint8_t _priHead;
+        volatile uint8_t _priTail;
+        volatile bool _priInLine;
+        uint8_t _priWriteHead;
+        bool _priMode;
+        bool _priOverflow;
+
+        uint16_t _txHighWater;
+        uint16_t _txBlocked;
+        uint16_t _priDropped;
+
+        void writeBulk(uint8_t c);
+        void writePriority(uint8_t c);
+        void enableTxInterrupt();
+        uint16_t txCount();
+};
+
+extern SerialPort serialPort;
+
+#endif
@@ -20,11 +20,6 @@ Stepper::Stepper(uint8_t stepPin, uint8_t dirPin, uint8_t homePin) {
 
     _homeSearchDir = '+';
     _homeSearchDist = labs(homeSearchDistDefault);
-
-    _running = false;
-    _homing = false;
-    _currentPos = 0;
-    _targetPos = 0;
     _homePos = 0;
 }
 
@@ -49,70 +44,31 @@ void Stepper::initialize() {
 
 }
 
-void Stepper::start() {
-    // Should be called in an atomic block
-    _running = true;
-}
-
-void Stepper::stop() {
-    // Should be called in an atomic block
-    _running = false;
-}
-
-void Stepper::home() {
-    int homeVal = digitalRead(_homePin);
-    if (homeVal == LOW) {
-        _homing = false;
-        _running = false;
-        _currentPos = _homePos;
-    } 
-    else {
-        // Should be called in an atomic block
-        if (_homeSearchDir == '+') {
-            _targetPos = _currentPos + labs(_homeSearchDist);
-        }
-        else {
-            _targetPos = _currentPos - labs(_homeSearchDist);
-        }
-        _homing = true;
-        _running = true;
-    }
-}
-
-bool Stepper::isRunning() {
-    return _running;
+uint8_t Stepper::getStepBitMask() {
+    return _stepBitMask;
 }
 
-void Stepper::setTargetPosition(long position) {
-    _targetPos = position;
+volatile uint8_t *Stepper::getStepPortReg() {
+    return _stepPortReg;
 }
 
-long Stepper::getTargetPosition() {
-    return _targetPos;
+uint8_t Stepper::getDirBitMask() {
+    return _dirBitMask;
 }
 
-long Stepper::getCurrentPosition() {
-    return _currentPos;
+volatile uint8_t *Stepper::getDirPortReg() {
+    return _dirPortReg;
 }
 
-void Stepper::setCurrentPosition(long position) {
-    _targetPos = position;
-    _currentPos = position;
+bool Stepper::isHomeInputActive() {
+    // The home switch pulls the input low
+    return (digitalRead(_homePin) == LOW);
 }
 
 void Stepper::setHomePosition(long position) {
     _homePos = position;
 }
 
-bool Stepper::isHome() {
-    if (_currentPos == _homePos) {
-        return true;
-    }
-    else {
-        return false;
-    }
-}
-
 long Stepper::getHomePosition() {
     return _homePos;
 }
@@ -158,11 +114,10 @@ void Stepper::setDirNormal() {
     setPinsInverted(false,false);
 }
 
-void Stepper::homeAction() {
-    if (_homing) {
-        _homing = false;
-        _running = false;
-        _currentPos = _homePos;
-    }
+bool Stepper::isDirInverted() {
+    return _dirInverted;
 }
 
+bool Stepper::isStepInverted() {
+    return _stepInverted;
+}
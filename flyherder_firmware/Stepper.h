@@ -11,6 +11,9 @@
 #endif
 
 
+// Pin assignment and homing configuration of a single axis. The step state
+// used by the timer interrupt (positions, rates and running flags) is kept by
+// MotorDrive in per-axis arrays.
 class Stepper {
 
     public:
@@ -21,26 +24,24 @@ class Stepper {
 
         void initialize();
 
-        void start();
-        void stop();
-        void home();
-        bool isRunning();
-
         void disableOutputs();
         void enableOutputs();
 
-        void setTargetPosition(long position);
-        long getTargetPosition();
-        long getCurrentPosition();  
-        void setCurrentPosition(long position);  
-
         void setPinsInverted(bool direction, bool step);
         void setDirInverted();
         void setDirNormal();
+        bool isDirInverted();
+        bool isStepInverted();
+
+        uint8_t getStepBitMask();
+        volatile uint8_t *getStepPortReg();
+        uint8_t getDirBitMask();
+        volatile uint8_t *getDirPortReg();
+
+        bool isHomeInputActive();
 
         void setHomePosition(long position);
         long getHomePosition();
-        bool isHome();
 
         void setHomeSearchNeg();
         void setHomeSearchPos();
@@ -49,22 +50,18 @@ class Stepper {
         void setHomeSearchDist(long dist);
         long getHomeSearchDist();
 
-        void updateDirPin();
-        void setStepPinHigh();
-        void setStepPinLow();
-        void homeAction();
-
     private:
 
         uint8_t _stepPin; 
         uint8_t _dirPin; 
         uint8_t _homePin;
 
-        volatile bool _dirInverted;
-        volatile bool _stepInverted;
+        bool _dirInverted;
+        bool _stepInverted;
 
         char _homeSearchDir;
         long _homeSearchDist;
+        long _homePos;
 
         uint8_t _stepBitMask;
         uint8_t _dirBitMask;
@@ -73,59 +70,6 @@ class Stepper {
         volatile uint8_t *_dirPortReg;
         volatile uint8_t *_stepPortReg;
 
-        volatile bool _running;
-        volatile bool _homing;
-        volatile long _currentPos;   // Steps  
-        volatile long _targetPos;    // Steps
-        volatile long _homePos;
-
 };
 
-inline void Stepper::updateDirPin() {
-    if (_running) {
-        if (_currentPos <= _targetPos) {
-            if (_dirInverted) {
-                *_dirPortReg &= ~ _dirBitMask;
-            }
-            else {
-                *_dirPortReg |= _dirBitMask;
-            }
-            _currentPos += 1;
-        }
-        else if (_currentPos > _targetPos) {
-            if (_dirInverted) {
-                *_dirPortReg |= _dirBitMask;
-            }
-            else {
-                *_dirPortReg &= ~ _dirBitMask;
-            }
-            _currentPos -= 1;
-        }
-    }
-}
-
-inline void Stepper::setStepPinHigh() {
-    if (_running) {
-        if (_stepInverted) {
-            *_stepPortReg &= ~_stepBitMask;
-        }
-        else { 
-            *_stepPortReg |= _stepBitMask;
-        }
-    }
-}
-
-inline void Stepper::setStepPinLow() {
-    if (_stepInverted) {
-        *_stepPortReg |= _stepBitMask;
-    }
-    else {
-        *_stepPortReg &= ~_stepBitMask;
-    }
-    if (_currentPos == _targetPos) {
-        _running = false;
-        _homing = false;
-    }
-}
-
 #endif 
@@ -1,3 +1,4 @@
+#include <util/atomic.h>
 #if defined(ARDUINO) && ARDUINO >= 100 
 #include "Arduino.h"
 #else
@@ -6,6 +7,7 @@
 #include <TimerOne.h>
 #include "string.h"
 #include "SystemState.h"
+#include "SerialPort.h"
 
 // Homing function interrupt table
 void (*homeFcnTable[constants::numAxis])(void) = {
@@ -16,7 +18,7 @@ void (*homeFcnTable[constants::numAxis])(void) = {
         };
 
 SystemState::SystemState() {
-    setErrMsg("");
+    setErrCode(errNone);
     disableBoundsCheck();
 }
 
@@ -24,6 +26,18 @@ void SystemState::initialize() {
     Timer1.initialize(1000); // Dummpy period
     Timer1.attachInterrupt(timerUpdate);
     motorDrive.initialize();
+    _speed = constants::speedDefault;
+    _acceleration = constants::accelerationDefault;
+    _junctionDeviation = constants::junctionDeviationDefault;
+    _timedMove = false;
+    _emergencyStop = false;
+    _feedOverrideNext = false;
+    _triggerNum = 0;
+    _triggerEdge = 'N';
+    _compareOutPin = -1;
+    _comparePulseWidth = 0;
+    _positionStoreMoving = false;
+    _positionStoreRestTime = 0;
     setDrivePowerOff();
 #ifdef  HAVE_ENABLE
     disable();
@@ -32,6 +46,8 @@ void SystemState::initialize() {
     setMaxSeparationToDefault();
     setOrientationToDefault();
     setupHoming();
+    restorePosition();
+    serialPort.setRxFastPath(serialRxFcn);
     Timer1.start();
     setLedStatusOn();
 }
@@ -44,7 +60,7 @@ void SystemState::setupHoming() {
     long homePosSteps;
     long homeSearchDistSteps;
     for (int i=0; i<constants::numAxis; i++) {
-        attachInterrupt(constants::homeInterruptArray[i], homeFcnTable[i], FALLING);
+        attachInterrupt(constants::homeInterruptArray[i], homeFcnTable[i], CHANGE);
         axisSepMM = getMaxSeparation(i%constants::numDim);
         if (i < constants::numDim) {
             homePosMM = 0.0;
@@ -66,7 +82,7 @@ void SystemState::setupHoming() {
 
 bool SystemState::enableBoundsCheck() {
     Array<float, constants::numAxis> posMM;
-    posMM = getPosition();
+    getPosition(posMM);
     if (!checkPosBounds(posMM)) {return false;} 
     _boundsCheck = true;
     return true;
@@ -80,23 +96,23 @@ bool SystemState::isBoundsCheckEnabled() {
     return _boundsCheck;
 }
 
-bool SystemState::checkPosBounds(Array<float, constants::numAxis> posMM) {
+bool SystemState::checkPosBounds(const Array<float, constants::numAxis> &posMM) {
     Array<long, constants::numAxis> posStep;
-    posStep = convertMMToSteps(posMM);
+    convertMMToSteps(posMM,posStep);
     for (int i=0; i<constants::numAxis; i++) {
         if (posStep[i] < 0) { 
-            setErrMsg("position is less than 0");
+            setErrCode(errPositionNegative);
             return false;
         }
         if (posStep[i] > convertMMToSteps(_maxSeparation[i%constants::numDim])) {
-            setErrMsg("position is greater than max separation");
+            setErrCode(errPositionSeparation);
             return false;
 
         }
     }
     for (int i=0; i<constants::numDim; i++) {
         if (posStep[i] > posStep[i+constants::numDim]) {
-            setErrMsg("position results in collision between axes");
+            setErrCode(errPositionCollision);
             return false;
         }
     }
@@ -124,6 +140,16 @@ bool SystemState::isDrivePowerOn() {
     return motorDrive.isPowerOn();
 }
 
+bool SystemState::isDriveReady() {
+    // True once the drive power has settled and the fault input is clear.
+    // Moves requested before then start when the drive becomes ready.
+    return motorDrive.isReady();
+}
+
+bool SystemState::checkDriveReadyEvent() {
+    return motorDrive.checkReadyEvent();
+}
+
 #ifdef HAVE_ENABLE
 void SystemState::enable() {
     motorDrive.enable();
@@ -142,52 +168,439 @@ void SystemState::stop() {
     motorDrive.stopAll();
 }
 
+void SystemState::emergencyStop() {
+    // Called from the serial receive interrupt on the emergency stop byte.
+    // Commands received ahead of the stop but not yet run are discarded, and
+    // no move can start until the stop has been reported from the main loop,
+    // see checkEmergencyStop.
+    motorDrive.emergencyStop();
+    serialPort.flushRx();
+    _emergencyStop = true;
+}
+
+bool SystemState::serialRxFastPath(uint8_t c) {
+    // Called from the serial receive interrupt for each byte. Handles the 
+    // fast path commands, which bypass the message parser and have no reply. 
+    // Returns true if the byte has been used.
+    //
+    //  emergencyStopByte          - stops all axes
+    //  feedOverrideByte, percent  - sets the feed override
+    //  startArmedByte             - starts the armed move
+    //
+    // The stop byte is checked first, so that it still stops if the percent
+    // byte after a feedOverrideByte was lost. It cannot be a valid percent.
+    if (c == constants::emergencyStopByte) {
+        _feedOverrideNext = false;
+        emergencyStop();
+        return true;
+    }
+    if (_feedOverrideNext) {
+        _feedOverrideNext = false;
+        motorDrive.setFeedOverride(c);
+        return true;
+    }
+    switch (c) {
+        case constants::feedOverrideByte:
+            _feedOverrideNext = true;
+            return true;
+        case constants::startArmedByte:
+            motorDrive.startArmed();
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool SystemState::checkEmergencyStop() {
+    // Returns true, once, after an emergency stop. Moves are allowed again 
+    // from here on, so the stop must be reported to the host before any 
+    // further command is run.
+    bool flag = false;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        flag = _emergencyStop;
+        _emergencyStop = false;
+        if (flag) {
+            motorDrive.releaseStop();
+        }
+    }
+    return flag;
+}
+
+bool SystemState::isDriveFault() {
+    return motorDrive.isFault();
+}
+
+bool SystemState::isDriveFaultInputActive() {
+    return motorDrive.isFaultInputActive();
+}
+
+bool SystemState::checkDriveFaultEvent() {
+    return motorDrive.checkFaultEvent();
+}
+
+bool SystemState::clearDriveFault() {
+    if (!motorDrive.clearFault()) {
+        setErrCode(errDriveFaultActive);
+        return false;
+    }
+    return true;
+}
+
+unsigned long SystemState::getDriveFaultTime() {
+    return motorDrive.getFaultTime();
+}
+
+uint8_t SystemState::getDriveFaultAxisMask() {
+    return motorDrive.getFaultAxisMask();
+}
+
+void SystemState::getDriveFaultPosition(Array<float,constants::numAxis> &posMM) {
+    // Axis positions at the time of the fault
+    Array<long,constants::numAxis> posSteps;
+    motorDrive.getFaultPositionAll(posSteps);
+    convertStepsToMM(posSteps,posMM);
+}
+
 bool SystemState::isRunning() {
     return motorDrive.isRunning();
 }
 
 
-bool SystemState::moveToPosition(Array<float,constants::numAxis> posMM) {
+bool SystemState::moveToPosition(const Array<float,constants::numAxis> &posMM) {
     Array<long,constants::numAxis> posStep;
+    if (!checkDriveFault()) {return false;}
+    if (!checkStopLatched()) {return false;}
     if (_boundsCheck) {
         if (!checkPosBounds(posMM)) {return false;}
     }
-    posStep = convertMMToSteps(posMM);
+    convertMMToSteps(posMM,posStep);
+    restoreSpeed();
     motorDrive.setTargetPositionAll(posStep);
     motorDrive.startAll();
     return true;
 }
 
+bool SystemState::armMove(const Array<float,constants::numAxis> &posMM) {
+    // Loads a move to posMM but does not start it. The move is started by the
+    // fast path startArmedByte, which lets the host start moves on several 
+    // devices at the same time.
+    Array<long,constants::numAxis> posStep;
+    if (!checkDriveFault()) {return false;}
+    if (!checkStopLatched()) {return false;}
+    if (isRunning()) {
+        setErrCode(errArmRunning);
+        return false;
+    }
+    if (_boundsCheck) {
+        if (!checkPosBounds(posMM)) {return false;}
+    }
+    convertMMToSteps(posMM,posStep);
+    restoreSpeed();
+    motorDrive.setTargetPositionAll(posStep);
+    motorDrive.armAll();
+    return true;
+}
+
+bool SystemState::isArmed() {
+    return motorDrive.isArmed();
+}
+
+void SystemState::cancelArmed() {
+    motorDrive.cancelArmed();
+}
+
+bool SystemState::setTrigger(int pin, char edge) {
+    // Sets the trigger input, which starts the armed move, to one of the 
+    // triggerPinArray pins and its active edge - 'R' (rising) or 'F' 
+    // (falling). Edge 'N' disables the trigger.
+    int num = -1;
+    for (int i=0; i<constants::numTrigger; i++) {
+        if (pin == constants::triggerPinArray[i]) {
+            num = i;
+        }
+    }
+    if (num < 0) {
+        setErrCode(errTriggerPin);
+        return false;
+    }
+    if ((edge != 'R') && (edge != 'F') && (edge != 'N')) {
+        setErrCode(errTriggerEdge);
+        return false;
+    }
+    if (_triggerEdge != 'N') {
+        detachInterrupt(constants::triggerInterruptArray[_triggerNum]);
+    }
+    _triggerNum = num;
+    _triggerEdge = edge;
+    if (edge != 'N') {
+        pinMode(pin, INPUT);
+        attachInterrupt(
+                constants::triggerInterruptArray[num], 
+                triggerFcn, 
+                (edge == 'R') ? RISING : FALLING
+                );
+    }
+    return true;
+}
+
+int SystemState::getTriggerPin() {
+    return constants::triggerPinArray[_triggerNum];
+}
+
+char SystemState::getTriggerEdge() {
+    return _triggerEdge;
+}
+
+long SystemState::getTriggerIsrTime() {
+    return motorDrive.getTriggerIsrTime();
+}
+
 bool SystemState::moveAxisToPosition(int axis, float posMM) {
     long posStep = convertMMToSteps(posMM);
     if (!checkAxisArg(axis))  {return false;}
+    if (!checkDriveFault()) {return false;}
+    if (!checkStopLatched()) {return false;}
     if (_boundsCheck) {
         Array<float, constants::numAxis> newPosMM;
-       newPosMM[axis] = posMM;
-      if (!checkPosBounds(newPosMM)) {return false;} 
+        getPosition(newPosMM);
+        newPosMM[axis] = posMM;
+        if (!checkPosBounds(newPosMM)) {return false;} 
     }
+    restoreSpeed(1 << axis);
     motorDrive.setTargetPosition(axis,posStep);
     motorDrive.start(axis);
     return true;
 }
 
+bool SystemState::moveToPositionInTime(const Array<float,constants::numAxis> &posMM, float t) {
+    // Moves all axes so that they arrive at the target position at the same 
+    // time t (s). The timer runs at the rate required by the axis with the 
+    // longest move and the remaining axes are divided down from it.
+    Array<long,constants::numAxis> posStep;
+    Array<long,constants::numAxis> curStep;
+    Array<long,constants::numAxis> dist;
+    long distMax = 0;
+    long period;
+    long numTicks;
+    if (!checkDriveFault()) {return false;}
+    if (!checkStopLatched()) {return false;}
+    if (t <= 0) {
+        setErrCode(errMoveTime);
+        return false;
+    }
+    if (isRunning()) {
+        setErrCode(errTimedMoveRunning);
+        return false;
+    }
+    if (_boundsCheck) {
+        if (!checkPosBounds(posMM)) {return false;}
+    }
+    convertMMToSteps(posMM,posStep);
+    motorDrive.getCurrentPositionAll(curStep);
+    for (int i=0; i<constants::numAxis; i++) {
+        dist[i] = labs(posStep[i] - curStep[i]);
+        if (convertStepsToMM(dist[i])/t > constants::maxSpeed) {
+            setErrCode(errSpeedMax);
+            return false;
+        }
+        if (dist[i] > distMax) {
+            distMax = dist[i];
+        }
+    }
+    if (distMax == 0) {
+        return true;
+    }
+
+    // Use the largest whole period which is short enough for the longest 
+    // move and then round the tick count so that the total move time is 
+    // within half a period of t.
+    period = (long) (1.0e6*t/distMax);
+    if (period > constants::maxTimerPeriod) {
+        period = constants::maxTimerPeriod;
+    }
+    numTicks = (long) (1.0e6*t/period + 0.5);
+    if (numTicks < distMax) {
+        numTicks = distMax;
+    }
+
+    motorDrive.setPeriod(period);
+    motorDrive.setTargetPositionAll(posStep);
+    motorDrive.setRateAll(dist,numTicks);
+    _timedMove = true;
+    motorDrive.startAll();
+    return true;
+}
+
+bool SystemState::moveArc(int herder, float xc, float yc, float angle) {
+    // Moves the herder (x/y axis pair) along a circular arc about the center
+    // (xc,yc) starting from its current position. The angle is in degrees, 
+    // positive values are counter clockwise.
+    int ix = herder*constants::numDim;
+    Array<float,constants::numAxis> posMM;
+    CurveGen curve;
+    float angleRad = angle*M_PI/180.0;
+    float radius;
+    float angle0;
+    float x;
+    float y;
+    if (!checkHerderArg(herder)) {return false;}
+    if (!checkDriveFault()) {return false;}
+    if (!checkStopLatched()) {return false;}
+    if ((angle < -360.0) || (angle > 360.0)) {
+        setErrCode(errArcAngle);
+        return false;
+    }
+    if (motorDrive.isPathActive()) {
+        // The path owns all axes until it ends, including while it waits 
+        // for its next point.
+        setErrCode(errPathRunning);
+        return false;
+    }
+    if (isHerderRunning(herder)) {
+        setErrCode(errHerderRunning);
+        return false;
+    }
+    getPosition(posMM);
+    x = posMM[ix] - xc;
+    y = posMM[ix+1] - yc;
+    radius = sqrt(x*x + y*y);
+    if (convertMMToSteps(radius) > CurveGen::maxExtent) {
+        setErrCode(errArcRadius);
+        return false;
+    }
+    if (_boundsCheck) {
+        // Check the end point and every extreme point of the circle within 
+        // the arc's sweep.
+        angle0 = atan2(y,x);
+        x = xc + radius*cos(angle0 + angleRad);
+        y = yc + radius*sin(angle0 + angleRad);
+        if (!checkHerderPosBounds(herder,x,y)) {return false;}
+        for (int i=-8; i<=8; i++) {
+            float da = i*M_PI/2.0 - angle0;
+            if (((angleRad >= 0) && (da >= 0) && (da <= angleRad)) ||
+                ((angleRad < 0) && (da <= 0) && (da >= angleRad))) 
+            {
+                x = xc + radius*cos(i*M_PI/2.0);
+                y = yc + radius*sin(i*M_PI/2.0);
+                if (!checkHerderPosBounds(herder,x,y)) {return false;}
+            }
+        }
+    }
+    curve.setArc(
+            motorDrive.getCurrentPosition(ix),
+            motorDrive.getCurrentPosition(ix+1),
+            convertMMToSteps(xc), 
+            convertMMToSteps(yc),
+            angleRad
+            );
+    restoreSpeed(3 << ix);
+    motorDrive.startCurve(herder,curve);
+    return true;
+}
+
+bool SystemState::moveBezier(int herder, const Array<float,3*constants::numDim> &ctrlPts) {
+    // Moves the herder (x/y axis pair) along a cubic Bezier curve starting from
+    // its current position. ctrlPts holds the remaining control points 
+    // x1, y1, x2, y2, x3, y3 where (x3,y3) is the end point.
+    int ix = herder*constants::numDim;
+    Array<long,3*constants::numDim> ctrlSteps;
+    long x0;
+    long y0;
+    CurveGen curve;
+    if (!checkHerderArg(herder)) {return false;}
+    if (!checkDriveFault()) {return false;}
+    if (!checkStopLatched()) {return false;}
+    if (motorDrive.isPathActive()) {
+        // The path owns all axes until it ends, including while it waits 
+        // for its next point.
+        setErrCode(errPathRunning);
+        return false;
+    }
+    if (isHerderRunning(herder)) {
+        setErrCode(errHerderRunning);
+        return false;
+    }
+    x0 = motorDrive.getCurrentPosition(ix);
+    y0 = motorDrive.getCurrentPosition(ix+1);
+    for (int i=0; i<3*constants::numDim; i++) {
+        ctrlSteps[i] = convertMMToSteps(ctrlPts[i]);
+        if (labs(ctrlSteps[i] - ((i%2 == 0) ? x0 : y0)) > CurveGen::maxExtent) {
+            setErrCode(errCurveControlPoints);
+            return false;
+        }
+    }
+    if (_boundsCheck) {
+        // The curve lies within the convex hull of its control points
+        for (int i=0; i<3; i++) {
+            if (!checkHerderPosBounds(herder,ctrlPts[2*i],ctrlPts[2*i+1])) {return false;}
+        }
+    }
+    curve.setBezier(
+            x0, y0,
+            ctrlSteps[0], ctrlSteps[1],
+            ctrlSteps[2], ctrlSteps[3],
+            ctrlSteps[4], ctrlSteps[5]
+            );
+    restoreSpeed(3 << ix);
+    motorDrive.startCurve(herder,curve);
+    return true;
+}
+
+bool SystemState::addPathPoint(const Array<float,constants::numAxis> &posMM) {
+    // Appends a straight segment, from the end of the previous one, to the
+    // continuous path. The path starts running as soon as the first point is
+    // added and runs through the corners between segments without stopping.
+    Array<long,constants::numAxis> posStep;
+    if (!checkDriveFault()) {return false;}
+    if (!checkStopLatched()) {return false;}
+    if (isRunning() && !motorDrive.isPathActive()) {
+        setErrCode(errPathRunning);
+        return false;
+    }
+    if (_boundsCheck) {
+        if (!checkPosBounds(posMM)) {return false;}
+    }
+    if (!motorDrive.isPathActive()) {
+        restoreSpeed();
+    }
+    convertMMToSteps(posMM,posStep);
+    motorDrive.setPathParams(
+            _acceleration*_stepsPerMM,
+            _junctionDeviation*_stepsPerMM,
+            constants::pathMinSpeed*_stepsPerMM
+            );
+    if (!motorDrive.addPathSegment(posStep, _speed*_stepsPerMM)) {
+        setErrCode(errPathBufferFull);
+        return false;
+    }
+    return true;
+}
+
+int SystemState::getPathFree() {
+    return motorDrive.getPathFree();
+}
+
 bool SystemState::moveToHome() {
+    if (!checkDriveFault()) {return false;}
+    if (!checkStopLatched()) {return false;}
+    restoreSpeed();
     motorDrive.homeAll();
     return true;
 }
 
 bool SystemState::moveAxisToHome(int axis) {
     if (!checkAxisArg(axis)) {return false;}
+    if (!checkDriveFault()) {return false;}
+    if (!checkStopLatched()) {return false;}
+    restoreSpeed(1 << axis);
     motorDrive.home(axis);
     return true;
 }
 
-Array<float,constants::numAxis> SystemState::getPosition() {
+void SystemState::getPosition(Array<float,constants::numAxis> &posMM) {
     Array<long, constants::numAxis> posSteps;
-    Array<float,constants::numAxis> posMM;
-    posSteps = motorDrive.getCurrentPositionAll();
-    posMM = convertStepsToMM(posSteps);
-    return posMM;
+    motorDrive.getCurrentPositionAll(posSteps);
+    convertStepsToMM(posSteps,posMM);
 }
 
 float SystemState::getAxisPosition(int axis) {
@@ -199,12 +612,118 @@ float SystemState::getAxisPosition(int axis) {
     return posMM;
 }
 
-bool SystemState::setPosition(Array<float, constants::numAxis> posMM) {
+void SystemState::getPositionSteps(Array<long,constants::numAxis> &posSteps) {
+    motorDrive.getCurrentPositionAll(posSteps);
+}
+
+void SystemState::getSnapshot(DriveSnapshot &snapshot) {
+    motorDrive.getSnapshot(snapshot);
+}
+
+long SystemState::getAxisPositionSteps(int axis) {
+    if (!checkAxisArg(axis)) {return 0;}
+    return motorDrive.getCurrentPosition(axis);
+}
+
+bool SystemState::getCapture(int axis, PositionCapture &capture) {
+    // Removes the oldest home input capture of the axis
+    if (!checkAxisArg(axis)) {return false;}
+    return motorDrive.getCapture(axis, capture);
+}
+
+bool SystemState::setCompareOutput(int pin, long pulseWidth) {
+    // Sets the compare output to one of the compareOutPinArray pins and the
+    // pulse width (us), 0 for the shortest pulse.
+    bool found = false;
+    for (int i=0; i<constants::numCompareOut; i++) {
+        if (pin == constants::compareOutPinArray[i]) {
+            found = true;
+        }
+    }
+    if (!found) {
+        setErrCode(errComparePin);
+        return false;
+    }
+    if ((pulseWidth < 0) || (pulseWidth > 0xffff)) {
+        setErrCode(errComparePulseWidth);
+        return false;
+    }
+    _compareOutPin = pin;
+    _comparePulseWidth = (unsigned int) pulseWidth;
+    motorDrive.setCompareOutput(pin,_comparePulseWidth);
+    return true;
+}
+
+int SystemState::getCompareOutputPin() {
+    return _compareOutPin;
+}
+
+unsigned int SystemState::getComparePulseWidth() {
+    return _comparePulseWidth;
+}
+
+bool SystemState::loadCompareTable(int axis, const float *posMM, int num) {
+    // Loads the compare positions (mm) of the axis, in increasing order.
+    long posSteps[constants::compareTableSize];
+    if (!checkAxisArg(axis)) {return false;}
+    if ((num < 0) || (num > constants::compareTableSize)) {
+        setErrCode(errCompareTableSize);
+        return false;
+    }
+    for (int i=0; i<num; i++) {
+        posSteps[i] = convertMMToSteps(posMM[i]);
+    }
+    if (!motorDrive.loadCompareTable(axis,posSteps,num)) {
+        setErrCode(errCompareTableOrder);
+        return false;
+    }
+    return true;
+}
+
+bool SystemState::setCompareInterval(int axis, long interval) {
+    if (!checkAxisArg(axis)) {return false;}
+    if (interval < 0) {
+        setErrCode(errCompareInterval);
+        return false;
+    }
+    return motorDrive.setCompareInterval(axis,interval);
+}
+
+bool SystemState::armCompare() {
+    if (_compareOutPin < 0) {
+        setErrCode(errCompareOutputNotSet);
+        return false;
+    }
+    if (!motorDrive.armCompare()) {
+        setErrCode(errCompareTableNotLoaded);
+        return false;
+    }
+    return true;
+}
+
+void SystemState::clearCompare() {
+    motorDrive.clearCompare();
+}
+
+bool SystemState::isCompareArmed() {
+    return motorDrive.isCompareArmed();
+}
+
+unsigned long SystemState::getComparePulseCount() {
+    return motorDrive.getComparePulseCount();
+}
+
+uint16_t SystemState::getCaptureLost(int axis) {
+    // Number of captures overwritten since the last call
+    return motorDrive.getCaptureLost(axis);
+}
+
+bool SystemState::setPosition(const Array<float, constants::numAxis> &posMM) {
     Array<long, constants::numAxis> posStep;
     if (_boundsCheck) {
         if (!checkPosBounds(posMM)) {return false;}
     }
-    posStep = convertMMToSteps(posMM);
+    convertMMToSteps(posMM,posStep);
     motorDrive.setCurrentPositionAll(posStep);
     return true;
 }
@@ -214,7 +733,7 @@ bool SystemState::setAxisPosition(int axis, float posMM) {
     if (!checkAxisArg(axis)) {return false;}
     if (_boundsCheck) {
         Array<float, constants::numAxis> newPosMM;
-        newPosMM = getPosition();
+        getPosition(newPosMM);
         newPosMM[axis] = posMM;
         if (!checkPosBounds(newPosMM)) {return false;}
     }
@@ -223,18 +742,100 @@ bool SystemState::setAxisPosition(int axis, float posMM) {
     return true;
 }
 
+void SystemState::restorePosition() {
+    // Loads the axis positions saved before the last reset. They are not 
+    // saved again until the host accepts them, or homes or sets the axes.
+    long posSteps[constants::numAxis];
+    _positionRestored = _positionStore.initialize();
+    if (_positionRestored) {
+        _positionStore.getPosition(posSteps);
+        for (int i=0; i<constants::numAxis; i++) {
+            motorDrive.setCurrentPosition(i,posSteps[i]);
+        }
+        motorDrive.setPositionKnownAll(false);
+    }
+}
+
+void SystemState::updatePositionStore() {
+    // Called from the main loop. Saves the new positions once the axes have 
+    // been at rest for constants::positionSaveDelay, so that a run of moves
+    // with short pauses between them writes nothing, and marks the saved 
+    // positions as in motion when the axes next start moving. The mark is 
+    // written once per saved record, not once per move. Nothing is saved 
+    // unless all positions are known.
+    DriveSnapshot snapshot;
+    _positionStore.update();
+    if (isRunning()) {
+        if (!_positionStoreMoving) {
+            _positionStore.markMoving();
+            _positionStoreMoving = true;
+        }
+        return;
+    }
+    if (_positionStoreMoving) {
+        _positionStoreMoving = false;
+        _positionStoreRestTime = millis();
+    }
+    if (millis() - _positionStoreRestTime < constants::positionSaveDelay) {
+        return;
+    }
+    if (!motorDrive.isPositionKnownAll() || isDriveFault()) {
+        return;
+    }
+    motorDrive.getSnapshot(snapshot);
+    _positionStore.save(snapshot.position);
+}
+
+bool SystemState::isPositionRestored() {
+    // True if positions were restored at startup and have been neither 
+    // accepted nor rejected, and no axis has been homed or set since.
+    return _positionRestored && !motorDrive.isPositionKnownAll();
+}
+
+bool SystemState::isStoredPositionStale() {
+    return _positionStore.isStale();
+}
+
+void SystemState::getStoredPosition(Array<float,constants::numAxis> &posMM) {
+    long posSteps[constants::numAxis];
+    _positionStore.getPosition(posSteps);
+    for (int i=0; i<constants::numAxis; i++) {
+        posMM[i] = convertStepsToMM(posSteps[i]);
+    }
+}
+
+uint16_t SystemState::getPositionStoreCount() {
+    return _positionStore.getCount();
+}
+
+bool SystemState::acceptStoredPosition() {
+    if (!isPositionRestored()) {
+        setErrCode(errNoRestoredPosition);
+        return false;
+    }
+    motorDrive.setPositionKnownAll(true);
+    _positionRestored = false;
+    return true;
+}
+
+void SystemState::rejectStoredPosition() {
+    // The axes must then be homed, or their positions set, before positions 
+    // are saved again.
+    _positionRestored = false;
+}
+
 void SystemState::setMaxSeparationToDefault() { 
     for (int i=0; i<constants::numDim; i++) {
         _maxSeparation[i] = constants::maxSeparationDefault;
     }
 }
 
-bool SystemState::setMaxSeparation(Array<float,constants::numDim> maxSeparation) {
+bool SystemState::setMaxSeparation(const Array<float,constants::numDim> &maxSeparation) {
     float homePosMM;
     long homePosStep;
     for (int i=0; i<constants::numDim; i++) {
         if (maxSeparation[i] <= 0) {
-            setErrMsg("separation value <= 0");
+            setErrCode(errSeparation);
             return false;
         }
     }
@@ -255,7 +856,7 @@ bool SystemState::setMaxSeparation(Array<float,constants::numDim> maxSeparation)
     return true;
 }
 
-Array<float,constants::numDim> SystemState::getMaxSeparation() {
+const Array<float,constants::numDim> &SystemState::getMaxSeparation() {
     return _maxSeparation;
 }
 
@@ -270,11 +871,11 @@ float SystemState::getMaxSeparation(unsigned int dim) {
 
 bool SystemState::setSpeed(float v) {
     if (v < constants::minSpeed) {
-        setErrMsg("speed <  min allowed value");
+        setErrCode(errSpeedMin);
         return false;
     }
     if (v > constants::maxSpeed) {
-        setErrMsg("speed > max allowed value");
+        setErrCode(errSpeedMax);
         return false;
     }
     unsigned int vSteps = (unsigned int) convertMMToSteps(v);
@@ -283,10 +884,80 @@ bool SystemState::setSpeed(float v) {
     return true;
 }
 
+void SystemState::setMaxSpeedPeriod() {
+    // The step timer is never run faster than at constants::maxSpeed, e.g.
+    // by a feed override above 100%.
+    long vSteps = convertMMToSteps(constants::maxSpeed);
+    motorDrive.setMinPeriod(1000000/max(vSteps,1L));
+}
+
+void SystemState::restoreSpeed(uint8_t axisMask) {
+    // Returns the step timer and axis rates to the global speed setting 
+    // after a timed move. axisMask has the axes taken over by the new move.
+    // The timer period is shared by all axes, so while any other axis is 
+    // still moving only the new move's axes are returned to the default rate
+    // and the timer is left for a later move to restore.
+    if (!_timedMove) {
+        return;
+    }
+    for (int i=0; i<constants::numAxis; i++) {
+        if (axisMask & (1 << i)) {
+            continue;
+        }
+        if (motorDrive.isAxisRunning(i) || motorDrive.isCurveActive(i/constants::numDim)) {
+            for (int j=0; j<constants::numAxis; j++) {
+                if (axisMask & (1 << j)) {
+                    motorDrive.setRate(j,1,1);
+                }
+            }
+            return;
+        }
+    }
+    unsigned int vSteps = (unsigned int) convertMMToSteps(_speed);
+    motorDrive.setRateAllToDefault();
+    motorDrive.setSpeed(vSteps);
+    _timedMove = false;
+}
+
 float SystemState::getSpeed() {
     return _speed;
 }
 
+int SystemState::getFeedOverride() {
+    // Feed override (%) currently applied, ramps towards the target
+    return motorDrive.getFeedOverride();
+}
+
+int SystemState::getFeedOverrideTarget() {
+    return motorDrive.getFeedOverrideTarget();
+}
+
+bool SystemState::setAcceleration(float accel) {
+    if (accel <= 0) {
+        setErrCode(errAcceleration);
+        return false;
+    }
+    _acceleration = accel;
+    return true;
+}
+
+float SystemState::getAcceleration() {
+    return _acceleration;
+}
+
+bool SystemState::setJunctionDeviation(float deviation) {
+    if (deviation < 0) {
+        setErrCode(errJunctionDeviation);
+        return false;
+    }
+    _junctionDeviation = deviation;
+    return true;
+}
+
+float SystemState::getJunctionDeviation() {
+    return _junctionDeviation;
+}
+
 bool SystemState::isInHomePosition() {
     // NOT DONE
     bool rtnVal = false;
@@ -297,12 +968,13 @@ bool SystemState::isInHomePosition() {
     return rtnVal;
 }
 
-bool SystemState::setOrientation(Array<char,constants::numAxis> orientation) {
+bool SystemState::setOrientation(const Array<char,constants::numAxis> &orientation) {
     for (int i=0; i<constants::numAxis; i++) {
         if (!setAxisOrientation(i,orientation[i])) {
             return false;
         }
     }
+    return true;
 }
 
 bool SystemState::setAxisOrientation(int axis, char orientation) {
@@ -314,7 +986,7 @@ bool SystemState::setAxisOrientation(int axis, char orientation) {
         }
     }
     if (!test) {
-        setErrMsg("uknown value for orientation");
+        setErrCode(errOrientation);
         return false;
     }
     motorDrive.setDirection((unsigned int) axis, orientation);
@@ -323,12 +995,11 @@ bool SystemState::setAxisOrientation(int axis, char orientation) {
 }
 
 void SystemState::setOrientationToDefault() {
-    Array<char,constants::numAxis> orientation = 
-        Array<char,constants::numAxis>(constants::orientationDefault);
+    Array<char,constants::numAxis> orientation(constants::orientationDefault);
     setOrientation(orientation);
 }
 
-Array<char,constants::numAxis> SystemState::getOrientation() {
+const Array<char,constants::numAxis> &SystemState::getOrientation() {
     return _orientation;
 }
 
@@ -339,14 +1010,16 @@ char SystemState::getAxisOrientation(int axis) {
 
 void SystemState::setStepsPerMMToDefault() { 
     _stepsPerMM = constants::stepsPerMMDefault;
+    setMaxSpeedPeriod();
 }
 
 bool SystemState::setStepsPerMM(float stepsPerMM) {
     if (stepsPerMM <= 0) {
-        setErrMsg("stepsPerMM <= 0");
+        setErrCode(errStepsPerMM);
         return false;
     }
     _stepsPerMM = stepsPerMM;
+    setMaxSpeedPeriod();
     return true;
 }
 
@@ -355,13 +1028,31 @@ float SystemState::getStepsPerMM() {
 }
 
 
-void SystemState::setErrMsg(char *msg) {
-    strncpy(errMsg,msg,SYS_ERR_BUF_SZ);
+void SystemState::setErrCode(uint8_t code) {
+    errCode = code;
+}
+
+bool SystemState::checkDriveFault() {
+    if (motorDrive.isFault()) {
+        setErrCode(errDriveFault);
+        return false;
+    }
+    return true;
+}
+
+bool SystemState::checkStopLatched() {
+    // The drive also refuses to start while the stop is latched, this only
+    // reports it.
+    if (motorDrive.isStopLatched()) {
+        setErrCode(errEmergencyStop);
+        return false;
+    }
+    return true;
 }
 
 bool SystemState::checkAxisArg(int axis) {
     if ((axis<0) || (axis >= constants::numAxis)) {
-        setErrMsg("axis argument out of range");
+        setErrCode(errAxisOutOfRange);
         return false;
     }
     else {
@@ -369,6 +1060,32 @@ bool SystemState::checkAxisArg(int axis) {
     }
 }
 
+bool SystemState::checkHerderArg(int herder) {
+    if ((herder<0) || (herder >= constants::numHerder)) {
+        setErrCode(errHerderOutOfRange);
+        return false;
+    }
+    else {
+        return true;
+    }
+}
+
+bool SystemState::checkHerderPosBounds(int herder, float x, float y) {
+    Array<float,constants::numAxis> posMM;
+    getPosition(posMM);
+    posMM[herder*constants::numDim] = x;
+    posMM[herder*constants::numDim+1] = y;
+    return checkPosBounds(posMM);
+}
+
+bool SystemState::isHerderRunning(int herder) {
+    int ix = herder*constants::numDim;
+    if (motorDrive.isCurveActive(herder)) {
+        return true;
+    }
+    return motorDrive.isAxisRunning(ix) || motorDrive.isAxisRunning(ix+1);
+}
+
 long SystemState::convertMMToSteps(float x) {
     return (long)(_stepsPerMM*x);
 }
@@ -377,26 +1094,24 @@ float SystemState::convertStepsToMM(long x) {
     return ((float)x)/_stepsPerMM;
 }
 
-Array<long, constants::numAxis>  SystemState::convertMMToSteps(
-        Array<float, constants::numAxis> posMM
+void SystemState::convertMMToSteps(
+        const Array<float, constants::numAxis> &posMM,
+        Array<long, constants::numAxis> &posSteps
         ) 
 {
-    Array<long, constants::numAxis> posSteps;
     for (int i=0; i<constants::numAxis; i++) {
         posSteps[i] = convertMMToSteps(posMM[i]);
     }
-    return posSteps;
 }
 
-Array<float, constants::numAxis> SystemState::convertStepsToMM(
-        Array<long, constants::numAxis> posSteps
+void SystemState::convertStepsToMM(
+        const Array<long, constants::numAxis> &posSteps,
+        Array<float, constants::numAxis> &posMM
         )
 {
-    Array<float, constants::numAxis> posMM;
     for (int i=0; i<constants::numAxis; i++) {
         posMM[i] = convertStepsToMM(posSteps[i]);
     }
-    return posMM;
 }
 
 SystemState systemState;
@@ -3,8 +3,8 @@
 #include "constants.h"
 #include "Array.h"
 #include "MotorDrive.h"
-
-enum {SYS_ERR_BUF_SZ=50};
+#include "PositionStore.h"
+#include "ErrorTable.h"
 
 class SystemState {
 
@@ -16,6 +16,8 @@ class SystemState {
         void setDrivePowerOn();
         void setDrivePowerOff();
         bool isDrivePowerOn();
+        bool isDriveReady();
+        bool checkDriveReadyEvent();
 
 #ifdef HAVE_ENABLE
         void enable();
@@ -23,31 +25,83 @@ class SystemState {
         bool isEnabled();
 #endif
         void stop();
+        void emergencyStop();
+        bool checkEmergencyStop();
+        bool serialRxFastPath(uint8_t c);
         bool isRunning();
 
-        bool moveToPosition(Array<float,constants::numAxis> posMM);
+        bool isDriveFault();
+        bool isDriveFaultInputActive();
+        bool checkDriveFaultEvent();
+        bool clearDriveFault();
+        unsigned long getDriveFaultTime();
+        uint8_t getDriveFaultAxisMask();
+        void getDriveFaultPosition(Array<float,constants::numAxis> &posMM);
+
+        bool moveToPosition(const Array<float,constants::numAxis> &posMM);
+        bool armMove(const Array<float,constants::numAxis> &posMM);
+        bool isArmed();
+        void cancelArmed();
+        bool setTrigger(int pin, char edge);
+        int getTriggerPin();
+        char getTriggerEdge();
+        long getTriggerIsrTime();
         bool moveAxisToPosition(int axis, float posMM);
+        bool moveToPositionInTime(const Array<float,constants::numAxis> &posMM, float t);
+        bool moveArc(int herder, float xc, float yc, float angle);
+        bool moveBezier(int herder, const Array<float,3*constants::numDim> &ctrlPts);
         bool moveToHome();
+        bool addPathPoint(const Array<float,constants::numAxis> &posMM);
+        int getPathFree();
         bool moveAxisToHome(int axis);
 
-        Array<float,constants::numAxis> getPosition();
+        void getPosition(Array<float,constants::numAxis> &posMM);
         float getAxisPosition(int axis);
-        bool setPosition(Array<float, constants::numAxis> pos);
+        void getPositionSteps(Array<long,constants::numAxis> &posSteps);
+        long getAxisPositionSteps(int axis);
+        void getSnapshot(DriveSnapshot &snapshot);
+        bool getCapture(int axis, PositionCapture &capture);
+        uint16_t getCaptureLost(int axis);
+        bool setCompareOutput(int pin, long pulseWidth);
+        int getCompareOutputPin();
+        unsigned int getComparePulseWidth();
+        bool loadCompareTable(int axis, const float *posMM, int num);
+        bool setCompareInterval(int axis, long interval);
+        bool armCompare();
+        void clearCompare();
+        bool isCompareArmed();
+        unsigned long getComparePulseCount();
+        bool setPosition(const Array<float, constants::numAxis> &posMM);
         bool setAxisPosition(int axis, float pos);
 
+        void updatePositionStore();
+        bool isPositionRestored();
+        bool isStoredPositionStale();
+        void getStoredPosition(Array<float,constants::numAxis> &posMM);
+        uint16_t getPositionStoreCount();
+        bool acceptStoredPosition();
+        void rejectStoredPosition();
+
         void setMaxSeparationToDefault();
-        bool setMaxSeparation(Array<float,constants::numDim> maxSeparation);
-        Array<float,constants::numDim> getMaxSeparation();
+        bool setMaxSeparation(const Array<float,constants::numDim> &maxSeparation);
+        const Array<float,constants::numDim> &getMaxSeparation();
         float getMaxSeparation(unsigned int dim);
 
         bool setSpeed(float v);
         float getSpeed();
+        int getFeedOverride();
+        int getFeedOverrideTarget();
+
+        bool setAcceleration(float accel);
+        float getAcceleration();
+        bool setJunctionDeviation(float deviation);
+        float getJunctionDeviation();
 
         bool isInHomePosition();
 
         void setOrientationToDefault();
-        bool setOrientation(Array<char,constants::numAxis> orientation);
-        Array<char,constants::numAxis> getOrientation();
+        bool setOrientation(const Array<char,constants::numAxis> &orientation);
+        const Array<char,constants::numAxis> &getOrientation();
 
         bool setAxisOrientation(int axis, char orientation);
         char getAxisOrientation(int axis);
@@ -59,13 +113,19 @@ class SystemState {
         void setLedStatusOn();
         void setLedStatusOff();
 
-        void setErrMsg(char *);
-        char errMsg[SYS_ERR_BUF_SZ];
+        void setErrCode(uint8_t code);
+        uint8_t errCode;  // See ErrorTable.h
 
         long convertMMToSteps(float x);
         float convertStepsToMM(long x);
-        Array<long, constants::numAxis> convertMMToSteps(Array<float, constants::numAxis> posMM);
-        Array<float, constants::numAxis> convertStepsToMM(Array<long, constants::numAxis> posSteps);
+        void convertMMToSteps(
+                const Array<float, constants::numAxis> &posMM, 
+                Array<long, constants::numAxis> &posSteps
+                );
+        void convertStepsToMM(
+                const Array<long, constants::numAxis> &posSteps,
+                Array<float, constants::numAxis> &posMM
+                );
 
         bool enableBoundsCheck();
         void disableBoundsCheck();
@@ -76,13 +136,33 @@ class SystemState {
     private:
 
         bool checkAxisArg(int axis);
-        bool checkPosBounds(Array<float,constants::numAxis> posMM);
+        bool checkDriveFault();
+        bool checkStopLatched();
+        bool checkHerderArg(int herder);
+        bool checkHerderPosBounds(int herder, float x, float y);
+        bool isHerderRunning(int herder);
+        bool checkPosBounds(const Array<float,constants::numAxis> &posMM);
+        void restoreSpeed(uint8_t axisMask=(1 << constants::numAxis)-1);
+        void setMaxSpeedPeriod();
+        void restorePosition();
         Array<float,constants::numDim> _maxSeparation;
         Array<char,constants::numAxis> _orientation;
         float _stepsPerMM;   
         float _speed;
         float _acceleration;
+        float _junctionDeviation;
         bool _boundsCheck;
+        bool _timedMove;
+        volatile bool _emergencyStop;
+        volatile bool _feedOverrideNext;
+        int _triggerNum;
+        char _triggerEdge;
+        int _compareOutPin;
+        unsigned int _comparePulseWidth;
+        PositionStore _positionStore;
+        bool _positionRestored;
+        bool _positionStoreMoving;
+        unsigned long _positionStoreRestTime;
         
 };
 
@@ -93,5 +173,8 @@ inline void Y0HomeFcn() {systemState.motorDrive.homeAction(1);}
 inline void X1HomeFcn() {systemState.motorDrive.homeAction(2);}
 inline void Y1HomeFcn() {systemState.motorDrive.homeAction(3);}
 inline void timerUpdate() {systemState.motorDrive.update();}
+inline void triggerFcn() {systemState.motorDrive.triggerAction();}
+
+inline bool serialRxFcn(uint8_t c) {return systemState.serialRxFastPath(c);}
 
 #endif
@@ -0,0 +1,352 @@
+// parse_bench.cpp
+//
+// Command parsing benchmark. Measures the host time to receive and read the
+// arguments of each type of command with the firmware's CommandParser, and,
+// for comparison, with a reference parser that works the way the
+// SerialReceiver library did: the message is kept as received and each read
+// finds the item by counting commas, copies it out and converts it with atof
+// or atol, and axis names are matched with strcmp against each name in turn.
+//
+// Host times are only a guide to the relative cost on the AVR, where float
+// conversion is far more expensive compared to integer arithmetic. The
+// values read by the two parsers are also compared, so that the benchmark
+// doubles as a check of CommandParser's number parsing, along with a check
+// of the integer range. Results are written as JSON.
+#include <stdio.h>
+#include <time.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include <limits.h>
+#include "sim.h"
+#include "CommandParser.h"
+#include "constants.h"
+
+const double minSeconds = 0.2;
+const int minRepeats = 5;
+const long batchSize = 2000;
+const float floatRelTol = 1.0e-6;
+
+// Reference parser
+// ----------------------------------------------------------------------------
+class RefParser {
+
+    public:
+        RefParser() {reset();}
+
+        void reset() {
+            _len = 0;
+            _inMessage = false;
+            _ready = false;
+        }
+
+        void process(int c) {
+            if (c == '[') {
+                reset();
+                _inMessage = true;
+            }
+            else if (c == ']') {
+                _buf[_len] = '\0';
+                _inMessage = false;
+                _ready = true;
+            }
+            else if (_inMessage && (_len < PARSER_BUF_SZ-1)) {
+                _buf[_len++] = c;
+            }
+        }
+
+        bool messageReady() {return _ready;}
+
+        void copyString(int item, char *str, int size) {
+            const char *s = _buf;
+            int n = 0;
+            for (int k=0; (k < item) && *s; s++) {
+                if (*s == ',') {
+                    k++;
+                }
+            }
+            while (*s == ' ') {
+                s++;
+            }
+            while (*s && (*s != ',') && (n < size-1)) {
+                str[n++] = *s++;
+            }
+            str[n] = '\0';
+        }
+
+        long readLong(int item) {
+            char str[PARSER_BUF_SZ];
+            copyString(item, str, sizeof(str));
+            return atol(str);
+        }
+
+        float readFloat(int item) {
+            char str[PARSER_BUF_SZ];
+            copyString(item, str, sizeof(str));
+            return (float) atof(str);
+        }
+
+    private:
+        char _buf[PARSER_BUF_SZ];
+        int _len;
+        bool _inMessage;
+        bool _ready;
+};
+
+// Axis lookup, as in MessageHandler
+// ----------------------------------------------------------------------------
+int8_t axisHashTable[8];
+
+void setupAxisHash() {
+    for (int i=0; i<8; i++) {
+        axisHashTable[i] = -1;
+    }
+    for (int i=0; i<constants::numAxis; i++) {
+        uint8_t slot = CommandParser::nameHash(constants::axisNames[i]) & 7;
+        if (axisHashTable[slot] >= 0) {
+            fprintf(stderr, "axis name hash collision\n");
+            exit(1);
+        }
+        axisHashTable[slot] = i;
+    }
+}
+
+int findAxis(CommandParser &parser, int item) {
+    int i = axisHashTable[parser.itemHash(item) & 7];
+    if ((i >= 0) && parser.itemEquals(item, constants::axisNames[i])) {
+        return i;
+    }
+    return -1;
+}
+
+int findAxis(RefParser &parser, int item) {
+    char name[constants::nameSize];
+    parser.copyString(item, name, constants::nameSize);
+    for (int i=0; i<constants::numAxis; i++) {
+        if (strcmp(name, constants::axisNames[i]) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Commands
+// ----------------------------------------------------------------------------
+// The argument types, one character per item after the command id: i - int,
+// f - float, a - axis name. MATLAB sends a space after each comma and
+// floats with %f.
+struct Command {
+    const char *name;
+    const char *msg;
+    const char *types;
+};
+
+const Command commands[] = {
+    {"getPosition",                "[40]",                                 ""},
+    {"setCompareOutput",           "[48,22,100]",                          "ii"},
+    {"moveAxisToPosition",         "[25,y1,123.456]",                      "af"},
+    {"moveToPosition",             "[23,10.5,20.25,30.125,40.0625]",       "ffff"},
+    {"moveToPosition_matlab",      "[23, 10.500000, 20.250000, 30.125000, 40.062500]", "ffff"},
+    {"moveToPositionInTime",       "[26,1e-05,0.333333333333,99.99,-0.5,2.5]", "fffff"},
+    {"moveBezier",                 "[28,1,0.0,0.0,12.5,50.0,100.0,100.0]", "iffffff"},
+    {"loadCompareTable",           "[50,x0,1.0,2.5,5.0,7.5,10.0,12.5,15.0,17.5]", "affffffff"},
+};
+const int numCommands = sizeof(commands)/sizeof(commands[0]);
+
+// Values read from a command, kept so that the reads are not optimized away
+// and so that the two parsers can be compared.
+struct Values {
+    long cmdId;
+    long ints[PARSER_MAX_ITEMS];
+    float floats[PARSER_MAX_ITEMS];
+};
+
+template <class Parser>
+void parseCommand(Parser &parser, const Command &cmd, Values &values) {
+    for (const char *c=cmd.msg; *c; c++) {
+        parser.process(*c);
+    }
+    if (!parser.messageReady()) {
+        fprintf(stderr, "%s: message not ready\n", cmd.name);
+        exit(1);
+    }
+    values.cmdId = parser.readLong(0);
+    for (int k=0; cmd.types[k]; k++) {
+        switch (cmd.types[k]) {
+            case 'i':
+                values.ints[k] = parser.readLong(k+1);
+                break;
+            case 'f':
+                values.floats[k] = parser.readFloat(k+1);
+                break;
+            case 'a':
+                values.ints[k] = findAxis(parser, k+1);
+                break;
+        }
+    }
+    parser.reset();
+}
+
+template <class Parser>
+double nsPerCommand(const Command &cmd) {
+    // Best of several repeats of a batch of the command
+    Parser parser;
+    Values values;
+    double elapsed = 0.0;
+    double best = 0.0;
+    int repeats = 0;
+    while ((elapsed < minSeconds) || (repeats < minRepeats)) {
+        struct timespec t0;
+        struct timespec t1;
+        double ns;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        for (long n=0; n<batchSize; n++) {
+            parseCommand(parser, cmd, values);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        ns = 1.0e9*(t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec);
+        elapsed += 1.0e-9*ns;
+        if ((repeats == 0) || (ns < best)) {
+            best = ns;
+        }
+        repeats++;
+    }
+    return best/batchSize;
+}
+
+int checkCommand(const Command &cmd) {
+    // Returns the number of items read differently by the two parsers
+    CommandParser parser;
+    RefParser refParser;
+    Values values;
+    Values refValues;
+    int errors = 0;
+    parseCommand(parser, cmd, values);
+    parseCommand(refParser, cmd, refValues);
+    if (values.cmdId != refValues.cmdId) {
+        errors++;
+    }
+    for (int k=0; cmd.types[k]; k++) {
+        if (cmd.types[k] == 'f') {
+            float ref = refValues.floats[k];
+            if (fabs(values.floats[k] - ref) > floatRelTol*fabs(ref)) {
+                fprintf(stderr, "%s: item %d is %.9g, expected %.9g\n", cmd.name, k+1, values.floats[k], ref);
+                errors++;
+            }
+        }
+        else if (values.ints[k] != refValues.ints[k]) {
+            fprintf(stderr, "%s: item %d is %ld, expected %ld\n", cmd.name, k+1, values.ints[k], refValues.ints[k]);
+            errors++;
+        }
+    }
+    return errors;
+}
+
+// Integer range
+// ----------------------------------------------------------------------------
+// Integer arguments which do not fit in a long, and some which only just
+// do, checked against the expected readLong result and isLong. Not compared
+// with the reference parser, as atol stops at the exponent.
+struct RangeCase {
+    const char *msg;
+    bool isLong;
+    long value;
+};
+
+const RangeCase rangeCases[] = {
+    {"[0,1e30]",    false, LONG_MAX},
+    {"[0,-1e30]",   false, LONG_MIN},
+    {"[0,9e99]",    false, LONG_MAX},
+    {"[0,0e99]",    true,  0},
+    {"[0,123e3]",   true,  123000},
+    {"[0,-5e-1]",   true,  0},
+    {"[0,1e-99]",   true,  0},
+};
+const int numRangeCases = sizeof(rangeCases)/sizeof(rangeCases[0]);
+
+int checkRange() {
+    // Returns the number of cases read incorrectly
+    int errors = 0;
+    for (int c=0; c<numRangeCases; c++) {
+        CommandParser parser;
+        for (const char *s=rangeCases[c].msg; *s; s++) {
+            parser.process(*s);
+        }
+        long value = parser.readLong(1);
+        bool isLong = parser.isLong(1);
+        if ((value != rangeCases[c].value) || (isLong != rangeCases[c].isLong)) {
+            fprintf(stderr, "%s: read %ld, isLong %d\n", rangeCases[c].msg, value, isLong);
+            errors++;
+        }
+    }
+    return errors;
+}
+
+// Main
+// ----------------------------------------------------------------------------
+void printUsage(const char *prog) {
+    fprintf(stderr, "usage: %s [-o file] [--command name]\n", prog);
+}
+
+int main(int argc, char *argv[]) {
+    const char *outName = 0;
+    const char *only = 0;
+    bool first = true;
+    int errors = 0;
+    int rangeErrors;
+    FILE *fp = stdout;
+
+    for (int k=1; k<argc; k++) {
+        if ((strcmp(argv[k], "-o") == 0) && (k+1 < argc)) {
+            outName = argv[++k];
+        }
+        else if ((strcmp(argv[k], "--command") == 0) && (k+1 < argc)) {
+            only = argv[++k];
+        }
+        else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    if (outName != 0) {
+        fp = fopen(outName, "w");
+        if (fp == 0) {
+            fprintf(stderr, "unable to open %s\n", outName);
+            return 1;
+        }
+    }
+    setupAxisHash();
+
+    fprintf(fp, "{\n");
+    fprintf(fp, "  \"bench\": \"command_parsing\",\n");
+    fprintf(fp, "  \"commands\": [\n");
+    for (int c=0; c<numCommands; c++) {
+        int cmdErrors;
+        double ns;
+        double refNs;
+        if ((only != 0) && (strcmp(only, commands[c].name) != 0)) {
+            continue;
+        }
+        cmdErrors = checkCommand(commands[c]);
+        ns = nsPerCommand<CommandParser>(commands[c]);
+        refNs = nsPerCommand<RefParser>(commands[c]);
+        fprintf(fp, first ? "" : ",\n");
+        fprintf(fp, "    {\"name\": \"%s\", \"bytes\": %d, \"parser_ns\": %.1f, "
+                "\"reference_ns\": %.1f, \"speedup\": %.2f, \"mismatches\": %d}",
+                commands[c].name, (int) strlen(commands[c].msg), ns, refNs,
+                (ns > 0.0) ? refNs/ns : 0.0, cmdErrors);
+        errors += cmdErrors;
+        first = false;
+    }
+    fprintf(fp, "\n  ],\n");
+    rangeErrors = checkRange();
+    fprintf(fp, "  \"range_cases\": %d,\n", numRangeCases);
+    fprintf(fp, "  \"range_mismatches\": %d\n", rangeErrors);
+    fprintf(fp, "}\n");
+    errors += rangeErrors;
+
+    if (fp != stdout) {
+        fclose(fp);
+    }
+    return (errors == 0) ? 0 : 1;
+}
@@ -0,0 +1,2 @@
+// Streaming.h - not used by the step engine, present so that the firmware
+// sources build unchanged on the host.
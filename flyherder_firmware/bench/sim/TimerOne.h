@@ -0,0 +1,30 @@
+// TimerOne.h - host model of the TimerOne library. The period is quantized
+// the same way as on the board: phase correct PWM on a 16 bit counter with
+// the smallest prescaler that fits.
+#ifndef _SIM_TIMER_ONE_H_
+#define _SIM_TIMER_ONE_H_
+
+#include <stdint.h>
+
+class TimerOne {
+
+    public:
+        TimerOne();
+
+        void initialize(long microseconds=1000000);
+        void setPeriod(long microseconds);
+        void attachInterrupt(void (*isr)(), long microseconds=-1);
+        void detachInterrupt();
+        void start();
+        void stop();
+
+        // Simulation state
+        uint32_t periodCycles;     // Timer period in CPU cycles
+        uint32_t setPeriodCount;   // Number of calls to setPeriod
+        bool running;
+        void (*isrCallback)();
+};
+
+extern TimerOne Timer1;
+
+#endif
@@ -0,0 +1,15 @@
+// avr/pgmspace.h - the host has one address space, so flash data is plain
+// data and is read directly.
+#ifndef _SIM_PGMSPACE_H_
+#define _SIM_PGMSPACE_H_
+
+#include <stdint.h>
+#include <string.h>
+
+#define PROGMEM
+#define PSTR(s) (s)
+#define pgm_read_byte(p) (*(const uint8_t *)(p))
+#define memcpy_P memcpy
+#define strlen_P strlen
+
+#endif
@@ -0,0 +1,157 @@
+#include "Arduino.h"
+#include "TimerOne.h"
+#include "sim.h"
+
+// Flat pin map - pin n is bit n%8 of port n/8. Port 0 is never used so that
+// the port number of a valid pin is non zero as on the board.
+const uint8_t pinsPerPort = 8;
+
+namespace sim {
+    uint64_t cycles = 0;
+    uint8_t portReg[numPorts];
+    uint8_t pinMode[numPins];
+    uint8_t pinInput[numPins];
+    uint8_t portInput[numPorts];
+    void (*interruptIsr[numInterrupts])(void);
+
+    void reset() {
+        cycles = 0;
+        memset(portReg, 0, sizeof(portReg));
+        memset(pinMode, INPUT, sizeof(pinMode));
+        memset(pinInput, HIGH, sizeof(pinInput));
+        memset(portInput, 0xff, sizeof(portInput));
+        for (int i=0; i<numInterrupts; i++) {
+            interruptIsr[i] = 0;
+        }
+    }
+}
+
+TimerOne Timer1;
+
+void pinMode(uint8_t pin, uint8_t mode) {
+    if (pin < sim::numPins) {
+        sim::pinMode[pin] = mode;
+    }
+}
+
+void digitalWrite(uint8_t pin, uint8_t val) {
+    volatile uint8_t *reg = portOutputRegister(digitalPinToPort(pin));
+    uint8_t mask = digitalPinToBitMask(pin);
+    if (val == LOW) {
+        *reg &= ~mask;
+    }
+    else {
+        *reg |= mask;
+    }
+}
+
+int digitalRead(uint8_t pin) {
+    if (pin >= sim::numPins) {
+        return LOW;
+    }
+    if (sim::pinMode[pin] == OUTPUT) {
+        uint8_t port = digitalPinToPort(pin);
+        return (sim::portReg[port] & digitalPinToBitMask(pin)) ? HIGH : LOW;
+    }
+    return sim::pinInput[pin];
+}
+
+uint8_t digitalPinToBitMask(uint8_t pin) {
+    return 1 << (pin % pinsPerPort);
+}
+
+uint8_t digitalPinToPort(uint8_t pin) {
+    return 1 + (pin/pinsPerPort) % (sim::numPorts - 1);
+}
+
+volatile uint8_t *portOutputRegister(uint8_t port) {
+    return &sim::portReg[port % sim::numPorts];
+}
+
+volatile uint8_t *portInputRegister(uint8_t port) {
+    return &sim::portInput[port % sim::numPorts];
+}
+
+void attachInterrupt(uint8_t num, void (*isr)(void), int mode) {
+    if (num < sim::numInterrupts) {
+        sim::interruptIsr[num] = isr;
+    }
+}
+
+void detachInterrupt(uint8_t num) {
+    if (num < sim::numInterrupts) {
+        sim::interruptIsr[num] = 0;
+    }
+}
+
+unsigned long micros() {
+    return (unsigned long) (sim::cycles/(F_CPU/1000000L));
+}
+
+unsigned long millis() {
+    return (unsigned long) (sim::cycles/(F_CPU/1000L));
+}
+
+void noInterrupts() {}
+
+void interrupts() {}
+
+// TimerOne model
+// ----------------------------------------------------------------------------
+const long timerResolution = 65536;
+
+TimerOne::TimerOne() {
+    periodCycles = 0;
+    setPeriodCount = 0;
+    running = false;
+    isrCallback = 0;
+}
+
+void TimerOne::initialize(long microseconds) {
+    setPeriod(microseconds);
+}
+
+void TimerOne::setPeriod(long microseconds) {
+    long cycles = (F_CPU/2000000)*microseconds;
+    long prescale;
+    if (cycles < timerResolution) {
+        prescale = 1;
+    }
+    else if ((cycles >>= 3) < timerResolution) {
+        prescale = 8;
+    }
+    else if ((cycles >>= 3) < timerResolution) {
+        prescale = 64;
+    }
+    else if ((cycles >>= 2) < timerResolution) {
+        prescale = 256;
+    }
+    else if ((cycles >>= 2) < timerResolution) {
+        prescale = 1024;
+    }
+    else {
+        cycles = timerResolution - 1;
+        prescale = 1024;
+    }
+    periodCycles = 2*cycles*prescale;
+    setPeriodCount++;
+}
+
+void TimerOne::attachInterrupt(void (*isr)(), long microseconds) {
+    if (microseconds > 0) {
+        setPeriod(microseconds);
+    }
+    isrCallback = isr;
+}
+
+void TimerOne::detachInterrupt() {
+    isrCallback = 0;
+}
+
+void TimerOne::start() {
+    running = true;
+}
+
+void TimerOne::stop() {
+    running = false;
+}
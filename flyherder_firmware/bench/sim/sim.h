@@ -0,0 +1,22 @@
+// sim.h - simulation state shared by the host Arduino core and the bench
+#ifndef _SIM_H_
+#define _SIM_H_
+
+#include <stdint.h>
+
+namespace sim {
+    enum {numPins=70};
+    enum {numPorts=16};
+    enum {numInterrupts=6};
+
+    extern uint64_t cycles;                  // Current time (CPU cycles)
+    extern uint8_t portReg[numPorts];
+    extern uint8_t pinMode[numPins];
+    extern uint8_t pinInput[numPins];        // Level read from input pins
+    extern uint8_t portInput[numPorts];      // Read through portInputRegister
+    extern void (*interruptIsr[numInterrupts])(void);
+
+    void reset();
+}
+
+#endif
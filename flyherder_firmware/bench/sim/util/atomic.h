@@ -0,0 +1,10 @@
+// util/atomic.h - the bench runs interrupts to completion between calls from
+// the main loop, so atomic blocks are plain blocks.
+#ifndef _SIM_ATOMIC_H_
+#define _SIM_ATOMIC_H_
+
+#define ATOMIC_RESTORESTATE
+#define ATOMIC_FORCEON
+#define ATOMIC_BLOCK(type) for (int _simAtomic=1; _simAtomic; _simAtomic=0)
+
+#endif
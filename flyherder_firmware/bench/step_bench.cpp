@@ -0,0 +1,748 @@
+// step_bench.cpp
+//
+// Step timing benchmark. Runs the firmware's Stepper/MotorDrive code on the
+// host against a cycle counting model of the board: Timer1 ticks are
+// quantized as by the TimerOne library, each interrupt is charged a cycle
+// cost from a simple cost model, and serial traffic is modelled as receive/
+// transmit interrupts plus the atomic sections of the main loop. Interrupts
+// that are blocked by other interrupts or atomic sections run late, and
+// timer ticks that arrive while an earlier tick is still pending are lost,
+// as on the AVR.
+//
+// For each scenario the step pulse times of every axis are recorded and
+// reported as interval statistics, a cycle-to-cycle jitter histogram and the
+// achieved step rate, together with the fraction of time spent in the
+// interrupts. Results are written as JSON. Each scenario is also checked
+// against constants::maxSpeed - the timer must never run faster than its
+// period, whatever the feed override - and the exit status is non-zero if 
+// one does.
+//
+// The cost model values are rough estimates for an ATmega2560 at 16 MHz.
+// They can be set with --cost name=cycles to match scope measurements of the
+// real board. With --host-timing the time per timer interrupt of the step
+// engine code itself is also measured on the host, for comparing changes to
+// the interrupt code.
+#include <stdio.h>
+#include <time.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include <stdint.h>
+#include <TimerOne.h>
+#include "sim.h"
+#include "MotorDrive.h"
+#include "CurveGen.h"
+#include "constants.h"
+
+const long cyclesPerUs = F_CPU/1000000L;
+const long histRangeUs = 1000;
+const long maxTicksDefault = 200000;
+const long sweepTicks = 5000;
+const long sweepMaxPeriodUs = 1000;
+const double hostTimingMinSeconds = 0.5;
+const int hostTimingMinRepeats = 10;
+
+// Cost model (CPU cycles)
+// ----------------------------------------------------------------------------
+struct CostModel {
+    long isrEntry;        // Timer interrupt entry/exit and call to update()
+    long axisIdle;        // Per axis, axis not running
+    long axisRunning;     // Per axis, axis running - rate divider and checks
+    long axisStep;        // Per step taken - dir/step pins and position
+    long curvePoint;      // Per chord loaded from a curve - point and rates
+    long pathTick;        // Path bookkeeping per tick
+    long pathLoad;        // Per path segment loaded
+    long pathRateUpdate;  // Path rate update at the acceleration tick
+    long serialRxByte;    // Receive interrupt per byte
+    long serialTxByte;    // Transmit interrupt per byte
+    long atomicSection;   // Interrupts disabled by the main loop per message
+};
+
+struct CostItem {
+    const char *name;
+    long CostModel::*member;
+};
+
+CostModel cost = {90, 12, 70, 45, 900, 60, 400, 3000, 100, 80, 400};
+
+const CostItem costItems[] = {
+    {"isr_entry", &CostModel::isrEntry},
+    {"axis_idle", &CostModel::axisIdle},
+    {"axis_running", &CostModel::axisRunning},
+    {"axis_step", &CostModel::axisStep},
+    {"curve_point", &CostModel::curvePoint},
+    {"path_tick", &CostModel::pathTick},
+    {"path_load", &CostModel::pathLoad},
+    {"path_rate_update", &CostModel::pathRateUpdate},
+    {"serial_rx_byte", &CostModel::serialRxByte},
+    {"serial_tx_byte", &CostModel::serialTxByte},
+    {"atomic_section", &CostModel::atomicSection},
+};
+const int numCostItems = sizeof(costItems)/sizeof(costItems[0]);
+
+// Serial traffic model - the host sends a short command and waits for the
+// reply, as the python and matlab clients do.
+struct SerialModel {
+    bool enabled;
+    long baudrate;
+    int cmdBytes;
+    int rspBytes;
+};
+
+SerialModel serial = {false, constants::baudrate, 8, 60};
+
+// Statistics
+// ----------------------------------------------------------------------------
+struct AxisStats {
+    long steps;
+    bool idle;                    // Axis stopped since the last step
+    uint64_t firstStep;
+    uint64_t lastStep;
+    int64_t lastInterval;
+    long numIntervals;
+    double sum;
+    double sumSq;
+    int64_t minInterval;
+    int64_t maxInterval;
+    long numJitter;
+    int64_t maxJitter;
+    long hist[2*histRangeUs+1];   // Cycle-to-cycle jitter, 1us bins
+};
+
+struct RunStats {
+    uint64_t cycles;
+    long ticks;
+    long missedTicks;
+    uint64_t timerCycles;
+    uint64_t serialCycles;
+    uint64_t maxLatency;
+    long messages;
+    uint32_t minPeriodCycles;
+    AxisStats axis[constants::numAxis];
+};
+
+void clearStats(RunStats &stats) {
+    memset(&stats, 0, sizeof(stats));
+}
+
+void addStep(AxisStats &axis, uint64_t t) {
+    // Intervals are only taken between steps of a continuous run of the axis
+    if (axis.idle) {
+        axis.lastInterval = 0;
+        axis.idle = false;
+    }
+    else if (axis.steps > 0) {
+        int64_t interval = (int64_t) (t - axis.lastStep);
+        if (axis.numIntervals == 0) {
+            axis.minInterval = interval;
+            axis.maxInterval = interval;
+        }
+        if (axis.lastInterval > 0) {
+            int64_t jitter = interval - axis.lastInterval;
+            long bin = (long) floor(((double) jitter)/cyclesPerUs + 0.5);
+            bin = max(-histRangeUs, min(histRangeUs, bin));
+            axis.hist[bin + histRangeUs]++;
+            axis.numJitter++;
+            axis.maxJitter = max(axis.maxJitter, llabs(jitter));
+        }
+        axis.minInterval = min(axis.minInterval, interval);
+        axis.maxInterval = max(axis.maxInterval, interval);
+        axis.sum += (double) interval;
+        axis.sumSq += ((double) interval)*((double) interval);
+        axis.numIntervals++;
+        axis.lastInterval = interval;
+    }
+    if (axis.steps == 0) {
+        axis.firstStep = t;
+    }
+    axis.lastStep = t;
+    axis.steps++;
+}
+
+// Simulation
+// ----------------------------------------------------------------------------
+MotorDrive drive;
+
+void benchTimerUpdate() {
+    drive.update();
+}
+
+// Switch positions used by the homing scenario. An axis' home input goes low
+// once it reaches its switch while homing.
+struct HomeModel {
+    bool enabled;
+    long switchPos[constants::numAxis];
+};
+
+HomeModel homeModel;
+
+class SerialState {
+    public:
+        SerialState() {
+            reset();
+        }
+        void reset() {
+            nextByte = 0;
+            rxCount = 0;
+            txCount = 0;
+        }
+        uint64_t nextByte;
+        int rxCount;
+        int txCount;
+};
+
+uint64_t serialByteCycles() {
+    return (uint64_t) (10*F_CPU/serial.baudrate);
+}
+
+uint64_t runSerial(SerialState &state, uint64_t until, uint64_t cpuFree, RunStats &stats) {
+    // Runs the serial interrupts and main loop atomic sections up to the
+    // given time. Returns the time at which the CPU is next free to service
+    // an interrupt.
+    while (state.nextByte <= until) {
+        uint64_t start = max(state.nextByte, cpuFree);
+        long isrCost;
+        if (state.rxCount < serial.cmdBytes) {
+            isrCost = cost.serialRxByte;
+            state.rxCount++;
+            if (state.rxCount == serial.cmdBytes) {
+                // Complete command - the main loop handles it with
+                // interrupts disabled while reading the drive state.
+                isrCost += cost.atomicSection;
+                state.txCount = 0;
+                stats.messages++;
+            }
+        }
+        else {
+            isrCost = cost.serialTxByte;
+            state.txCount++;
+            if (state.txCount == serial.rspBytes) {
+                state.rxCount = 0;
+            }
+        }
+        cpuFree = start + isrCost;
+        stats.serialCycles += isrCost;
+        state.nextByte += serialByteCycles();
+    }
+    return cpuFree;
+}
+
+int checkHomeSwitches() {
+    // Runs the home interrupt of each homing axis which has reached its 
+    // switch. Returns the number of interrupts run.
+    int count = 0;
+    if (!homeModel.enabled) {
+        return 0;
+    }
+    for (int i=0; i<constants::numAxis; i++) {
+        long pos = drive.getCurrentPosition(i);
+        bool reached = (drive.getHomeSearchDir(i) == '-') ?
+            (pos <= homeModel.switchPos[i]) : (pos >= homeModel.switchPos[i]);
+        if (drive.isAxisRunning(i) && reached) {
+            sim::pinInput[constants::homePinArray[i]] = LOW;
+            drive.homeAction(i);
+            count++;
+        }
+    }
+    return count;
+}
+
+struct TickInfo {
+    bool running[constants::numAxis];
+    long pos[constants::numAxis];
+    bool curveActive[constants::numHerder];
+    bool pathActive;
+    uint32_t setPeriodCount;
+};
+
+void getTickInfo(TickInfo &info) {
+    for (int i=0; i<constants::numAxis; i++) {
+        info.running[i] = drive.isAxisRunning(i);
+        info.pos[i] = drive.getCurrentPosition(i);
+    }
+    for (int h=0; h<constants::numHerder; h++) {
+        info.curveActive[h] = drive.isCurveActive(h);
+    }
+    info.pathActive = drive.isPathActive();
+    info.setPeriodCount = Timer1.setPeriodCount;
+}
+
+void runTimerTick(uint64_t start, RunStats &stats, uint64_t &cpuFree) {
+    // Runs one timer interrupt starting at the given time, records the steps
+    // taken and charges the interrupt's cost.
+    TickInfo before;
+    TickInfo after;
+    long pre = cost.isrEntry;
+    long offset;
+    long total;
+
+    getTickInfo(before);
+    sim::cycles = start;
+    Timer1.isrCallback();
+    getTickInfo(after);
+
+    if (before.pathActive) {
+        bool anyRunning = false;
+        for (int i=0; i<constants::numAxis; i++) {
+            anyRunning |= before.running[i];
+        }
+        pre += cost.pathTick;
+        if (!anyRunning) {
+            pre += cost.pathLoad;
+        }
+        if (after.setPeriodCount != before.setPeriodCount) {
+            pre += cost.pathRateUpdate;
+        }
+    }
+    for (int h=0; h<constants::numHerder; h++) {
+        int ix = h*constants::numDim;
+        if (before.curveActive[h] && !before.running[ix] && !before.running[ix+1]) {
+            pre += cost.curvePoint;
+        }
+    }
+
+    offset = pre;
+    for (int i=0; i<constants::numAxis; i++) {
+        // Step pins are set high in axis order in the first loop of update()
+        bool running = before.running[i] || after.running[i];
+        offset += running ? cost.axisRunning : cost.axisIdle;
+        if (after.pos[i] != before.pos[i]) {
+            offset += cost.axisStep;
+            addStep(stats.axis[i], start + offset);
+        }
+        else if (!after.running[i]) {
+            stats.axis[i].idle = true;
+        }
+    }
+    total = offset + constants::numAxis*cost.axisIdle;
+
+    total += checkHomeSwitches()*cost.isrEntry;
+
+    cpuFree = start + total;
+    stats.timerCycles += total;
+    stats.ticks++;
+}
+
+void run(RunStats &stats, long maxTicks) {
+    // Runs the timer interrupt, and the serial traffic when enabled, until
+    // the drive stops or maxTicks timer interrupts have run.
+    SerialState serialState;
+    uint64_t tick = Timer1.periodCycles;
+    uint64_t cpuFree = 0;
+    uint64_t start;
+
+    clearStats(stats);
+    stats.minPeriodCycles = Timer1.periodCycles;
+    while (drive.isRunning() && (stats.ticks < maxTicks)) {
+        if (serial.enabled) {
+            cpuFree = runSerial(serialState, tick, cpuFree, stats);
+        }
+        start = max(tick, cpuFree);
+        stats.maxLatency = max(stats.maxLatency, start - tick);
+        runTimerTick(start, stats, cpuFree);
+        stats.minPeriodCycles = min(stats.minPeriodCycles, Timer1.periodCycles);
+
+        // The timer flag is set once while the interrupt is pending, further
+        // ticks are lost.
+        tick += Timer1.periodCycles;
+        while (cpuFree > tick + Timer1.periodCycles) {
+            tick += Timer1.periodCycles;
+            stats.missedTicks++;
+        }
+    }
+    stats.cycles = max(tick, cpuFree);
+}
+
+void setupDrive() {
+    sim::reset();
+    Timer1 = TimerOne();
+    drive = MotorDrive();
+    homeModel.enabled = false;
+    Timer1.initialize(1000);
+    Timer1.attachInterrupt(benchTimerUpdate);
+    drive.initialize();
+    drive.setPowerOn();
+    // Skip the drive power settle time so that scenarios start with the
+    // drive ready.
+    sim::cycles += (uint64_t) constants::drivePowerSettleTime*(F_CPU/1000);
+    drive.update();
+    sim::cycles = 0;
+    Timer1.start();
+}
+
+unsigned int maxSpeedSteps() {
+    return (unsigned int) (constants::maxSpeed*constants::stepsPerMMDefault);
+}
+
+uint32_t maxSpeedPeriodCycles() {
+    // Timer period at constants::maxSpeed, quantized as by TimerOne. No 
+    // scenario, whatever the feed override, should run the timer faster.
+    TimerOne timer;
+    timer.setPeriod(1000000L/maxSpeedSteps());
+    return timer.periodCycles;
+}
+
+// Scenarios
+// ----------------------------------------------------------------------------
+void setupSingleAxis() {
+    drive.setSpeed(maxSpeedSteps());
+    drive.setTargetPosition(0, 20000);
+    drive.start(0);
+}
+
+void setupAllAxes() {
+    Array<long,constants::numAxis> pos(20000);
+    drive.setSpeed(maxSpeedSteps());
+    drive.setTargetPositionAll(pos);
+    drive.startAll();
+}
+
+void setupTimedMove() {
+    // Unequal distances in the same time - all but the longest axis step
+    // through the rate divider.
+    Array<long,constants::numAxis> pos;
+    for (int i=0; i<constants::numAxis; i++) {
+        pos[i] = 20000 - 5000*i;
+    }
+    drive.setSpeed(maxSpeedSteps());
+    drive.setTargetPositionAll(pos);
+    drive.setRateAll(pos, pos[0]);
+    drive.startAll();
+}
+
+void setupHoming() {
+    drive.setSpeed(maxSpeedSteps());
+    homeModel.enabled = true;
+    for (int i=0; i<constants::numAxis; i++) {
+        char dir = (i < constants::numDim) ? '-' : '+';
+        long start = (dir == '-') ? 15000 : -15000;
+        drive.setCurrentPosition(i, start);
+        drive.setHomePosition(i, 0);
+        drive.setHomeSearchDir(i, dir);
+        drive.setHomeSearchDist(i, 30000);
+        homeModel.switchPos[i] = 0;
+    }
+    drive.homeAll();
+}
+
+void setupAllAxesSerial() {
+    setupAllAxes();
+}
+
+void setupArc() {
+    CurveGen curve;
+    drive.setSpeed(maxSpeedSteps());
+    for (int h=0; h<constants::numHerder; h++) {
+        curve.setArc(0, 0, 5000, 0, (h == 0) ? 2.0*M_PI : -2.0*M_PI);
+        drive.startCurve(h, curve);
+    }
+}
+
+void setupPath() {
+    const long side = 5000;
+    const long corner[4][2] = {{side,0}, {side,side}, {0,side}, {0,0}};
+    float rate = constants::maxSpeed*constants::stepsPerMMDefault;
+    float accel = constants::accelerationDefault*constants::stepsPerMMDefault;
+    float deviation = constants::junctionDeviationDefault*constants::stepsPerMMDefault;
+    float minRate = constants::pathMinSpeed*constants::stepsPerMMDefault;
+    drive.setSpeed(maxSpeedSteps());
+    drive.setPathParams(accel, deviation, minRate);
+    for (int k=0; k<4; k++) {
+        Array<long,constants::numAxis> pos;
+        for (int i=0; i<constants::numAxis; i++) {
+            pos[i] = corner[k][i%constants::numDim];
+        }
+        drive.addPathSegment(pos, rate);
+    }
+}
+
+void setupAllAxesOverride() {
+    setupAllAxes();
+    drive.setFeedOverride(constants::feedOverrideMax);
+}
+
+void setupPathOverride() {
+    setupPath();
+    drive.setFeedOverride(constants::feedOverrideMax);
+}
+
+struct Scenario {
+    const char *name;
+    const char *description;
+    void (*setup)();
+    bool serial;
+};
+
+const Scenario scenarios[] = {
+    {"single_axis", "x0 only, 20000 steps at max speed", setupSingleAxis, false},
+    {"all_axes", "all axes, 20000 steps at max speed", setupAllAxes, false},
+    {"timed_move", "all axes, unequal distances through the rate divider", setupTimedMove, false},
+    {"homing", "all axes homing at max speed", setupHoming, false},
+    {"all_axes_serial", "all axes at max speed with serial command traffic", setupAllAxesSerial, true},
+    {"arc", "full circle on each herder", setupArc, false},
+    {"path", "square continuous path on each herder", setupPath, false},
+    {"all_axes_override", "all axes at max speed with the maximum feed override", setupAllAxesOverride, false},
+    {"path_override", "square path with the maximum feed override", setupPathOverride, false},
+};
+const int numScenarios = sizeof(scenarios)/sizeof(scenarios[0]);
+
+// Host timing - runs the scenario's timer interrupts back to back and 
+// returns the host time per interrupt in ns, best of several repeats.
+double hostNsPerTick(const Scenario &scenario, long numTicks) {
+    double elapsed = 0.0;
+    double best = 0.0;
+    int repeats = 0;
+    if (numTicks <= 0) {
+        return 0.0;
+    }
+    while ((elapsed < hostTimingMinSeconds) || (repeats < hostTimingMinRepeats)) {
+        struct timespec t0;
+        struct timespec t1;
+        double ns;
+        setupDrive();
+        scenario.setup();
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        for (long k=0; k<numTicks; k++) {
+            Timer1.isrCallback();
+            checkHomeSwitches();
+        }
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        ns = 1.0e9*(t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec);
+        elapsed += 1.0e-9*ns;
+        best = (repeats == 0) ? ns : min(best, ns);
+        repeats++;
+    }
+    return best/numTicks;
+}
+
+// Max step rate sweep - the shortest timer period at which n axes step every
+// tick, with serial traffic, without losing ticks.
+bool sweepOk(int numMoving, long periodUs) {
+    RunStats stats;
+    setupDrive();
+    drive.setMinPeriod(1);
+    drive.setPeriod(periodUs);
+    for (int i=0; i<numMoving; i++) {
+        drive.setTargetPosition(i, 10*sweepTicks);
+        drive.start(i);
+    }
+    run(stats, sweepTicks);
+    return (stats.missedTicks == 0);
+}
+
+long sweepMinPeriod(int numMoving) {
+    long lo = 1;
+    long hi = sweepMaxPeriodUs;
+    if (!sweepOk(numMoving, hi)) {
+        return -1;
+    }
+    while (lo < hi) {
+        long mid = (lo + hi)/2;
+        if (sweepOk(numMoving, mid)) {
+            hi = mid;
+        }
+        else {
+            lo = mid + 1;
+        }
+    }
+    return hi;
+}
+
+// JSON output
+// ----------------------------------------------------------------------------
+double cyclesToUs(double c) {
+    return c/cyclesPerUs;
+}
+
+void writeAxis(FILE *fp, int i, AxisStats &axis, bool last) {
+    double seconds = ((double) (axis.lastStep - axis.firstStep))/F_CPU;
+    double mean = 0.0;
+    double stddev = 0.0;
+    bool first = true;
+    if (axis.numIntervals > 0) {
+        mean = axis.sum/axis.numIntervals;
+        stddev = sqrt(max(0.0, axis.sumSq/axis.numIntervals - mean*mean));
+    }
+    fprintf(fp, "        {\"axis\": \"%s\", \"steps\": %ld, ", constants::axisNames[i], axis.steps);
+    fprintf(fp, "\"steps_per_s\": %.3f,\n", (seconds > 0) ? (axis.steps-1)/seconds : 0.0);
+    fprintf(fp, "         \"interval_us\": {\"mean\": %.3f, \"min\": %.3f, \"max\": %.3f, \"stddev\": %.3f},\n",
+            cyclesToUs(mean), cyclesToUs((double) axis.minInterval),
+            cyclesToUs((double) axis.maxInterval), cyclesToUs(stddev));
+    fprintf(fp, "         \"jitter_us\": {\"max\": %.3f, \"hist\": {", cyclesToUs((double) axis.maxJitter));
+    for (long b=0; b<2*histRangeUs+1; b++) {
+        if (axis.hist[b] > 0) {
+            fprintf(fp, "%s\"%ld\": %ld", first ? "" : ", ", b - histRangeUs, axis.hist[b]);
+            first = false;
+        }
+    }
+    fprintf(fp, "}}}%s\n", last ? "" : ",");
+}
+
+bool maxSpeedOk(RunStats &stats) {
+    return stats.minPeriodCycles >= maxSpeedPeriodCycles();
+}
+
+void writeScenario(FILE *fp, const Scenario &scenario, RunStats &stats, long periodUs, double hostNs) {
+    double seconds = ((double) stats.cycles)/F_CPU;
+    fprintf(fp, "    {\"name\": \"%s\",\n", scenario.name);
+    fprintf(fp, "     \"description\": \"%s\",\n", scenario.description);
+    fprintf(fp, "     \"serial\": %s,\n", scenario.serial ? "true" : "false");
+    fprintf(fp, "     \"period_us\": %ld,\n", periodUs);
+    fprintf(fp, "     \"duration_s\": %.6f,\n", seconds);
+    fprintf(fp, "     \"ticks\": %ld,\n", stats.ticks);
+    fprintf(fp, "     \"missed_ticks\": %ld,\n", stats.missedTicks);
+    fprintf(fp, "     \"max_latency_us\": %.3f,\n", cyclesToUs((double) stats.maxLatency));
+    fprintf(fp, "     \"isr_fraction\": %.6f,\n", ((double) stats.timerCycles)/stats.cycles);
+    fprintf(fp, "     \"serial_isr_fraction\": %.6f,\n", ((double) stats.serialCycles)/stats.cycles);
+    fprintf(fp, "     \"messages\": %ld,\n", stats.messages);
+    fprintf(fp, "     \"min_period_us\": %.3f,\n", cyclesToUs((double) stats.minPeriodCycles));
+    fprintf(fp, "     \"max_speed_ok\": %s,\n", maxSpeedOk(stats) ? "true" : "false");
+    if (hostNs > 0) {
+        fprintf(fp, "     \"host_ns_per_tick\": %.2f,\n", hostNs);
+    }
+    fprintf(fp, "     \"axes\": [\n");
+    for (int i=0; i<constants::numAxis; i++) {
+        writeAxis(fp, i, stats.axis[i], i == constants::numAxis-1);
+    }
+    fprintf(fp, "     ]}");
+}
+
+void writeCostModel(FILE *fp) {
+    fprintf(fp, "  \"cost_model\": {");
+    for (int k=0; k<numCostItems; k++) {
+        fprintf(fp, "%s\"%s\": %ld", (k == 0) ? "" : ", ", costItems[k].name, cost.*(costItems[k].member));
+    }
+    fprintf(fp, "},\n");
+}
+
+// Main
+// ----------------------------------------------------------------------------
+void printUsage(const char *prog) {
+    fprintf(stderr, "usage: %s [-o file] [--scenario name] [--baud rate] [--no-sweep]\n", prog);
+    fprintf(stderr, "          [--host-timing]\n");
+    fprintf(stderr, "          [--max-ticks n] [--cost name=cycles] ...\n");
+    fprintf(stderr, "cost model items:");
+    for (int k=0; k<numCostItems; k++) {
+        fprintf(stderr, " %s", costItems[k].name);
+    }
+    fprintf(stderr, "\n");
+}
+
+bool setCost(const char *arg) {
+    const char *eq = strchr(arg, '=');
+    if (eq == 0) {
+        return false;
+    }
+    for (int k=0; k<numCostItems; k++) {
+        if ((strlen(costItems[k].name) == (size_t) (eq - arg)) &&
+                (strncmp(costItems[k].name, arg, eq - arg) == 0)) {
+            cost.*(costItems[k].member) = atol(eq+1);
+            return true;
+        }
+    }
+    return false;
+}
+
+int main(int argc, char *argv[]) {
+    const char *outName = 0;
+    const char *only = 0;
+    long maxTicks = maxTicksDefault;
+    bool sweep = true;
+    bool hostTiming = false;
+    bool first = true;
+    bool speedOk = true;
+    FILE *fp = stdout;
+
+    for (int k=1; k<argc; k++) {
+        if ((strcmp(argv[k], "-o") == 0) && (k+1 < argc)) {
+            outName = argv[++k];
+        }
+        else if ((strcmp(argv[k], "--scenario") == 0) && (k+1 < argc)) {
+            only = argv[++k];
+        }
+        else if ((strcmp(argv[k], "--baud") == 0) && (k+1 < argc)) {
+            serial.baudrate = atol(argv[++k]);
+        }
+        else if ((strcmp(argv[k], "--max-ticks") == 0) && (k+1 < argc)) {
+            maxTicks = atol(argv[++k]);
+        }
+        else if ((strcmp(argv[k], "--cost") == 0) && (k+1 < argc)) {
+            if (!setCost(argv[++k])) {
+                printUsage(argv[0]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[k], "--no-sweep") == 0) {
+            sweep = false;
+        }
+        else if (strcmp(argv[k], "--host-timing") == 0) {
+            hostTiming = true;
+        }
+        else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    if (serial.baudrate <= 0) {
+        printUsage(argv[0]);
+        return 1;
+    }
+    if (outName != 0) {
+        fp = fopen(outName, "w");
+        if (fp == 0) {
+            fprintf(stderr, "unable to open %s\n", outName);
+            return 1;
+        }
+    }
+
+    fprintf(fp, "{\n");
+    fprintf(fp, "  \"bench\": \"step_timing\",\n");
+    fprintf(fp, "  \"cpu_hz\": %ld,\n", (long) F_CPU);
+    fprintf(fp, "  \"baudrate\": %ld,\n", serial.baudrate);
+    writeCostModel(fp);
+    fprintf(fp, "  \"scenarios\": [\n");
+    for (int s=0; s<numScenarios; s++) {
+        RunStats stats;
+        long periodUs;
+        double hostNs = 0.0;
+        if ((only != 0) && (strcmp(only, scenarios[s].name) != 0)) {
+            continue;
+        }
+        setupDrive();
+        scenarios[s].setup();
+        periodUs = Timer1.periodCycles/cyclesPerUs;
+        serial.enabled = scenarios[s].serial;
+        run(stats, maxTicks);
+        serial.enabled = false;
+        if (hostTiming) {
+            hostNs = hostNsPerTick(scenarios[s], stats.ticks);
+        }
+        fprintf(fp, first ? "" : ",\n");
+        writeScenario(fp, scenarios[s], stats, periodUs, hostNs);
+        if (!maxSpeedOk(stats)) {
+            fprintf(stderr, "%s: timer period below the max speed period\n", scenarios[s].name);
+            speedOk = false;
+        }
+        first = false;
+    }
+    fprintf(fp, "\n  ]%s\n", sweep ? "," : "");
+
+    if (sweep) {
+        fprintf(fp, "  \"max_step_rate\": [\n");
+        serial.enabled = true;
+        for (int n=1; n<=constants::numAxis; n++) {
+            long periodUs = sweepMinPeriod(n);
+            fprintf(fp, "    {\"moving_axes\": %d, \"min_period_us\": %ld, \"steps_per_s\": %.1f}%s\n",
+                    n, periodUs, (periodUs > 0) ? 1.0e6/periodUs : 0.0,
+                    (n == constants::numAxis) ? "" : ",");
+        }
+        serial.enabled = false;
+        fprintf(fp, "  ]\n");
+    }
+    fprintf(fp, "}\n");
+
+    if (fp != stdout) {
+        fclose(fp);
+    }
+    return speedOk ? 0 : 1;
+}
@@ -1,9 +1,18 @@
+#include <avr/pgmspace.h>
 #include "constants.h"
+
+// Build identifier reported in the ready banner and the device info. May be
+// set to a version control hash with -DFIRMWARE_ID="..." 
+#ifndef FIRMWARE_ID
+#define FIRMWARE_ID __DATE__ " " __TIME__
+#endif
+
 namespace constants {
     // Communications parameters
     const unsigned int baudrate = 9600;
     const unsigned int deviceModelNumber = 1105;
     const unsigned int deviceSerialNumber = 1267;
+    const char firmwareId[] PROGMEM = FIRMWARE_ID;
 
     // Axes & dimension properties
     const char dimNames[numDim][nameSize]= {"x", "y"};
@@ -14,6 +23,11 @@ namespace constants {
     const float speedDefault = 10.0;          // (mm/s)
     const float minSpeed = 0.1;               // (mm/s)
     const float maxSpeed = 90.0;              // (mm/s)
+    const long maxTimerPeriod = 8000000;      // (us)
+    const float accelerationDefault = 200.0;  // (mm/s^2)
+    const float junctionDeviationDefault = 0.05; // (mm)
+    const float pathMinSpeed = 1.0;           // (mm/s)
+    const long pathAccelTickPeriod = 10000;   // (us)
     const float stepsPerMMDefault = stepsPerRev/threadLead;  
     const float homeSearchDistScaleFact = 1.5;
 
@@ -30,8 +44,15 @@ namespace constants {
     const int driveDisablePin = 5;
 #endif
     const int driveFaultPin = 8;
+    const int driveFaultActiveLevel = 0;   // Active low
+    const unsigned long drivePowerSettleTime = 500; // (ms)
     const int stepPinArray[numAxis] = {37,35,33,31};
     const int dirPinArray[numAxis] = {36,34,32,30};
     const int homePinArray[numAxis] = {2,3,18,19}; 
     const int homeInterruptArray[numAxis] = {0,1,5,4};
+    const int triggerPinArray[numTrigger] = {21,20};
+    const int triggerInterruptArray[numTrigger] = {2,3};
+    const int compareOutPinArray[numCompareOut] = {22,23};
+    const int positionStoreAddress = 0;  // EEPROM
+    const unsigned long positionSaveDelay = 2000; // (ms) at rest before saving
 }
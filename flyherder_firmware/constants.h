@@ -6,11 +6,27 @@
 namespace constants {
     enum {numDim=2};
     enum {numAxis=2*numDim};    
+    enum {numHerder=numAxis/numDim};
     enum {nameSize=3};
     enum {numOrientation=2};
+    enum {pathBufferSize=8};
+    enum {emergencyStopByte=0x03};
+    enum {feedOverrideByte=0x04};
+    enum {startArmedByte=0x05};
+    enum {feedOverrideDefault=100};   // (%)
+    enum {feedOverrideMin=10};
+    enum {feedOverrideMax=200};
+    enum {feedOverrideRampStep=2};    // (%) per pathAccelTickPeriod
+    enum {captureBufferSize=8};
+    enum {captureDebounceTime=2000};  // (us)
+    enum {numTrigger=2};
+    enum {compareTableSize=8};
+    enum {numCompareOut=2};
+    enum {positionStoreSize=32};
     extern const unsigned int baudrate;
     extern const unsigned int deviceModelNumber;
     extern const unsigned int deviceSerialNumber; 
+    extern const char firmwareId[];  // In flash
     extern const char dimNames[numDim][nameSize];
     extern const char axisNames[numAxis][nameSize];
     extern const float stepsPerRev;
@@ -19,6 +35,11 @@ namespace constants {
     extern const float speedDefault; 
     extern const float minSpeed;
     extern const float maxSpeed;
+    extern const long maxTimerPeriod;
+    extern const float accelerationDefault;
+    extern const float junctionDeviationDefault;
+    extern const float pathMinSpeed;
+    extern const long pathAccelTickPeriod;
     extern const float stepsPerMMDefault;
     extern const float homeSearchDistScaleFact;
     extern const char allowedOrientation[numOrientation];
@@ -31,9 +52,16 @@ namespace constants {
 #endif
     extern const int drivePowerPin;
     extern const int driveFaultPin;
+    extern const int driveFaultActiveLevel;
+    extern const unsigned long drivePowerSettleTime;
     extern const int stepPinArray[numAxis];
     extern const int dirPinArray[numAxis];
     extern const int homePinArray[numAxis];
     extern const int homeInterruptArray[numAxis];
+    extern const int triggerPinArray[numTrigger];
+    extern const int triggerInterruptArray[numTrigger];
+    extern const int compareOutPinArray[numCompareOut];
+    extern const int positionStoreAddress;
+    extern const unsigned long positionSaveDelay;
 }
 #endif
@@ -1,17 +1,25 @@
 #include <Streaming.h>
 #include <TimerOne.h>
 #include "Stepper.h"
+#include "CurveGen.h"
+#include "PathPlanner.h"
+#include "CaptureBuffer.h"
+#include "CompareTable.h"
+#include "PositionStore.h"
 #include "MotorDrive.h"
-#include "SerialReceiver.h"
-#include "DictPrinter.h"
+#include "CommandParser.h"
+#include "SerialPort.h"
+#include "ReplyPrinter.h"
+#include "FrameLink.h"
 #include "Array.h"
 #include "MessageHandler.h"
 #include "SystemState.h"
 #include "constants.h"
 
 void setup() {
-    Serial.begin(constants::baudrate);
+    serialPort.begin(constants::baudrate);
     systemState.initialize();
+    messageHandler.sendReady();
 }
 
 void loop() { 
@@ -66,6 +66,26 @@
 %   * wait - waits until all moves currently running on the device have stopped.
 %     Usage: dev.wait()
 %
+%   * emergencyStop - stops all motion immediately. Sends the single byte
+%     emergency stop code, which the device acts on as soon as it is received.
+%     Commands sent before it that have not yet run are discarded, and moves
+%     are refused until the device has sent the 'emergencyStop' event.
+%     Does not wait for a response.
+%     Usage: dev.emergencyStop()
+%
+%   * startArmed - starts the move loaded with armMove. Sent as a fast path
+%     command without a response.
+%     Usage: dev.startArmed()
+%
+%   * getEvents - returns a cell array of the events received from the device
+%     since the last call and clears it.
+%     Usage: events = dev.getEvents()
+%
+%   * setFeedOverride - sets the feed override (%, 10 to 200), which scales
+%     the speed of all moves including the one in progress. The device ramps
+%     to the new value. Sent as a fast path command without a response.
+%     Usage: dev.setFeedOverride(percent)
+%
 %   * printDynamicMethods - prints the names of all dynamically generated class 
 %     methods. Note, the device must be opened for this command to work.
 %     Usage: dev.printDynamicMethods()
@@ -112,6 +132,22 @@
 %   * isDrivePowerOn - returns true or false based on whether or not drive power is on.
 %     Usage: value = dev.isDrivePowerOn()
 %     
+%   * isDriveReady - returns true or false based on whether or not the drive
+%     is ready, i.e., drive power is on and has settled and the fault input
+%     is clear. setDrivePowerOn waits until the drive is ready.
+%     Usage: value = dev.isDriveReady()
+%
+%   * getFaultStatus - returns the drive fault status. The fault input is
+%     watched while drive power is on. A fault stops all axes and is latched,
+%     moves fail until it is cleared. Returns the latched fault flag, the
+%     state of the fault input, the time (ms) of the fault, a bit mask of the
+%     axes running at the time and the axis positions at the time.
+%     Usage: faultStatus = dev.getFaultStatus()
+%
+%   * clearFault - clears a latched drive fault. Fails if the fault input is
+%     still active.
+%     Usage: dev.clearFault()
+%
 %   * stop - stops all currently running moves.
 %     Usage: dev.stop()
 %    
@@ -124,11 +160,68 @@
 %      - x0, y0, x1, y1 are the position (mm) of the axes with the same name or 
 %      - pos is a structure with fields x0, y0, x1, y1 specifying the axis positions (mm)
 %
+%   * armMove - loads a move to the given position without starting it. The
+%     move is started with startArmed. Not allowed while running.
+%     Usage: dev.armMove(x0, y0, x1, y1) or dev.armMove(pos), arguments as 
+%     for moveToPosition
+%
+%   * isArmed - returns true if a move loaded with armMove is waiting to start
+%     Usage: value = dev.isArmed()
+%
+%   * cancelArmed - cancels the armed move
+%     Usage: dev.cancelArmed()
+%
+%   * setTrigger - sets the trigger input which starts the armed move.
+%     Usage: dev.setTrigger(pin, edge) where
+%      - pin is the trigger input pin, 21 or 20
+%      - edge is 'R' (rising), 'F' (falling) or 'N' (trigger disabled)
+%
+%   * getTrigger - returns a structure with the trigger pin and edge and the
+%     time (us) the last trigger interrupt took from its entry to the first
+%     step, -1 if none.
+%     Usage: trigger = dev.getTrigger()
+%
 %   * moveAxisToPosition - moves the specified axis to the given position
 %     Usage: dev.moveAxisToPosition(axisName, position)
 %       - axisName = name of axis to move 'x0', 'y0', 'x1', or 'y1'
 %       - position = position to which axis should be moved
 %
+%   * moveToPositionInTime - move system to given position such that all axes
+%     arrive at the same time, t seconds after the move starts. The device rejects 
+%     the move if any axis would have to move faster than the maximum speed.
+%     Usage: dev.moveToPositionInTime(x0, y0, x1, y1, t) or 
+%            dev.moveToPositionInTime(pos, t) where
+%      - x0, y0, x1, y1 are the position (mm) of the axes with the same name or 
+%      - pos is a structure with fields x0, y0, x1, y1 specifying the axis positions (mm)
+%      - t is the duration of the move (s)
+%
+%   * moveArc - moves a herder along a circular arc starting from its current
+%     position. A herder is an x/y axis pair, herder 0 is x0, y0 and herder 1
+%     is x1, y1. The arc is generated on the device.
+%     Usage: dev.moveArc(herder, xc, yc, angle) where
+%      - herder = herder number, 0 or 1
+%      - xc, yc = center of the arc (mm)
+%      - angle = arc angle in degrees, positive is counter clockwise 
+%
+%   * moveBezier - moves a herder along a cubic Bezier curve starting from its 
+%     current position. The curve is generated on the device.
+%     Usage: dev.moveBezier(herder, x1, y1, x2, y2, x3, y3) where
+%      - herder = herder number, 0 or 1
+%      - x1, y1, x2, y2 = intermediate control points (mm)
+%      - x3, y3 = end point of the curve (mm)
+%
+%   * addPathPoint - appends a straight segment, from the end of the previous
+%     point, to the continuous path. The path starts as soon as the first point
+%     is added and runs through the corners without stopping. The speed through
+%     each corner is set by the acceleration and the junction deviation. Returns
+%     the number of free entries in the device's path buffer.
+%     Usage: free = dev.addPathPoint(x0,y0,x1,y1) or free = dev.addPathPoint(pos)
+%      - x0, y0, x1, y1 = position of the next path point in mm
+%      - pos = structure with fields 'x0', 'y0', 'x1', 'y1'
+%
+%   * getPathFree - returns the number of free entries in the path buffer.
+%     Usage: free = dev.getPathFree()
+%
 %   * moveToHome - move the system to the home position. Uses the limit switches 
 %     to determine whether or not the home positions has been reached.
 %     Usage: dev.moveToHome()
@@ -165,6 +258,55 @@
 %     Usage:  pos = dev.getAxisPosition(axisName)
 %      - axisName = 'x0', 'y0', 'x1', 'y1'
 %
+%   * getPositionSteps - returns a structure with fields 'x0', 'y0', 'x1', 'y1'
+%     whose values are the current position of the device in steps. The reply
+%     is shorter and faster than getPosition. Divide by the value returned by 
+%     getStepsPerMM to convert to mm.
+%     Usage: pos = dev.getPositionSteps()
+%
+%   * getAxisPositionSteps - returns the position of the specified axis in steps.
+%     Usage:  pos = dev.getAxisPositionSteps(axisName)
+%      - axisName = 'x0', 'y0', 'x1', 'y1'
+%
+%   * getSnapshot - returns the axis positions (steps), the running axes (bit
+%     mask) and the step timer tick count, all sampled on the same tick.
+%     Usage: snapshot = dev.getSnapshot()
+%
+%   * getCaptures - returns, and removes, the positions latched by the edges
+%     of the specified axis' home input. Every edge is captured, not only
+%     those during homing, so that lost steps show up as drift in the switch
+%     position, except for switch bounce: an edge within 2 ms of the previous
+%     edge is dropped. Returns the step counts (steps), the times in us (time), the
+%     edges (edge, 'F' switch closed, 'R' switch opened) and the number of
+%     captures lost to buffer overflow since the last call (lost).
+%     Usage:  captures = dev.getCaptures(axisName)
+%      - axisName = 'x0', 'y0', 'x1', 'y1'
+%
+%   * setCompareOutput - sets the output pin, 22 or 23, pulsed when an axis
+%     hits a compare table position, and the pulse width (us). The pulse ends
+%     on the first step timer tick after the width, 0 gives the shortest pulse.
+%     Usage: dev.setCompareOutput(pin, pulseWidth)
+%
+%   * loadCompareTable - loads up to 8 compare positions (mm), in increasing
+%     order, for the specified axis. A pulse fires when the axis reaches one 
+%     of them from either side. Disarms the axis' table.
+%     Usage: dev.loadCompareTable(axisName, p1, p2, ...)
+%
+%   * setCompareInterval - sets the axis to also pulse every n steps, 0 for 
+%     none. Disarms the axis' table.
+%     Usage: dev.setCompareInterval(axisName, n)
+%
+%   * armCompare - arms the compare tables of all axes with positions or an 
+%     interval loaded and clears the pulse count.
+%     Usage: dev.armCompare()
+%
+%   * clearCompare - disarms and clears the compare tables of all axes.
+%     Usage: dev.clearCompare()
+%
+%   * getCompareStatus - returns a structure with the output pin, the pulse
+%     width, whether the tables are armed and the pulse count.
+%     Usage: status = dev.getCompareStatus()
+%
 %   * setPosition - set the current position of the system to the current values. 
 %     Note, does not move the system - just sets the position value.
 %     Usage: dev.setPosition(x0,y0,x1,y1) or dev.setPosition(pos) where
@@ -178,6 +320,21 @@
 %      - axisName = 'x0', 'y0', 'x1', 'y1'
 %      - pos = position in mm
 %
+%   * getStoredPosition - returns the axis positions last saved to EEPROM,
+%     which are saved once the axes have been at rest for 2 s and all
+%     positions are known (homed or set). restored is 1 if they were restored at
+%     startup and wait to be accepted or rejected; stale is 1 if the axes 
+%     started moving after they were saved, e.g. power was lost mid move.
+%     Usage: stored = dev.getStoredPosition()
+%
+%   * acceptStoredPosition - accepts the positions restored at startup,
+%     so that the axes need not be homed.
+%     Usage: dev.acceptStoredPosition()
+%
+%   * rejectStoredPosition - rejects the positions restored at startup. 
+%     The axes must then be homed or have their positions set.
+%     Usage: dev.rejectStoredPosition()
+%
 %   * setSpeed - sets the desired operating speed for the all axes. 
 %     Usage: dev.setSpeed(speed)
 %      - speed = desired speed mm/s, allowed arange 0.1mm/s to 90mm/s
@@ -185,6 +342,24 @@
 %   * getSpeed - returns the current operating speed in in mm/s
 %     Usage: speed in dev.getSpeed()
 %
+%   * getFeedOverride - returns the feed override (%) currently applied
+%     (feedOverride) and the value it is ramping to (feedOverrideTarget).
+%     Usage: feed = dev.getFeedOverride()
+%
+%   * setAcceleration - sets the acceleration used by continuous paths.
+%     Usage: dev.setAcceleration(accel)
+%      - accel = acceleration in mm/s^2
+%
+%   * getAcceleration - returns the path acceleration in mm/s^2
+%     Usage: accel = dev.getAcceleration()
+%
+%   * setJunctionDeviation - sets how far, in mm, a continuous path may deviate 
+%     from its corners. Larger values give faster corners. 
+%     Usage: dev.setJunctionDeviation(deviation)
+%
+%   * getJunctionDeviation - returns the path junction deviation in mm
+%     Usage: deviation = dev.getJunctionDeviation()
+%
 %   * setOrientation - sets the orientation values for all axis. Note, an axis can be in 
 %     normal, '+', orientatin or in inverted, '-', orientation. The output of the direction
 %     pin is inverted when an axis's orientatin is inverted. 
@@ -236,6 +411,20 @@
 %   * getModelNumber - returns the device model number
 %     Usage: modelNum = dev.getModelNumber()
 %
+%   * getSerialStats - returns serial port queue statistics: free space in
+%     the transmit buffer, its high water mark, the number of writes which
+%     waited for buffer space, dropped priority replies, receive buffer
+%     overflows, and framed commands refused (frameNak) or answered from
+%     the kept reply (frameReplay) - see the Python SerialDevice framed
+%     option.
+%     Usage: stats = dev.getSerialStats()
+%
+%   * getCmdArgs - returns the argument types of each command, one character
+%     per argument: f - number, i - integer, a - axis name, c - character,
+%     and a trailing * for any number of the last argument. Arguments are
+%     checked against these on the device before the command is run.
+%     Usage: args = dev.getCmdArgs()
+%
 
 classdef FlyHerderSerial < handle 
     
@@ -250,6 +439,8 @@ classdef FlyHerderSerial < handle
         rspCodeStruct = [];
         orderedAxisNames = {};
         orderedDimNames = {};
+        eventCell = {};
+        readyStruct = [];
 
     end
 
@@ -261,10 +452,15 @@ classdef FlyHerderSerial < handle
         stopbits = 1;
         timeout = 1.0;
         terminator = 'LF';
-        resetDelay = 2.0;
+        readyTimeout = 3.0;
         inputBufferSize = 2048;
         waitPauseDt = 0.25;
-        powerOnDelay = 1.5;
+        powerOnTimeout = 5.0;
+        readyPauseDt = 0.02;
+        emergencyStopByte = 3;
+        feedOverrideByte = 4;
+        startArmedByte = 5;
+        feedOverrideRange = [10, 200];
 
         % Command ids for basic commands.
         cmdIdGetDevInfo = 0;
@@ -301,7 +497,7 @@ classdef FlyHerderSerial < handle
             % Open - opens a serial connection to the fly herder hardware.
             if obj.isOpen == false
                 fopen(obj.dev);
-                pause(obj.resetDelay);
+                obj.waitReady();
                 obj.createRspCodeStruct();
                 obj.createDevInfoStruct();
                 obj.createCmdIdStruct();
@@ -380,6 +576,46 @@ classdef FlyHerderSerial < handle
             end
         end
 
+        function emergencyStop(obj)
+            % emergencyStop - stops all motion immediately by sending the single
+            % byte emergency stop code. Does not wait for a response.
+            if obj.isOpen
+                fwrite(obj.dev, obj.emergencyStopByte, 'uint8');
+            end
+        end
+
+        function startArmed(obj)
+            % startArmed - starts the move loaded with armMove by sending the
+            % single byte start code. Does not wait for a response.
+            if obj.isOpen
+                fwrite(obj.dev, obj.startArmedByte, 'uint8');
+            end
+        end
+
+        function setFeedOverride(obj,percent)
+            % setFeedOverride - sets the feed override (%). Does not wait for
+            % a response.
+            percent = round(percent);
+            if percent < obj.feedOverrideRange(1) || percent > obj.feedOverrideRange(2)
+                ME = MException( ...
+                    'FlyHerderSerial:feedOverrideRange', ...
+                    'feed override must be in range %d to %d', ...
+                    obj.feedOverrideRange(1), obj.feedOverrideRange(2) ...
+                    );
+                throw(ME);
+            end
+            if obj.isOpen
+                fwrite(obj.dev, [obj.feedOverrideByte, percent], 'uint8');
+            end
+        end
+
+        function events = getEvents(obj)
+            % getEvents - returns the events received from the device since the
+            % last call and clears them.
+            events = obj.eventCell;
+            obj.eventCell = {};
+        end
+
         function varargout = subsref(obj,S)
             % subsref - overloaded subsref function to enable dynamic generation of 
             % class methods from the cmdIdStruct structure. 
@@ -418,23 +654,31 @@ classdef FlyHerderSerial < handle
                 end
                 fprintf(obj.dev,'%c\n',cmdStr);
 
-                % Get response as json string and parse
-                rspStrJson = fscanf(obj.dev,'%c');
-                if obj.debug
-                    fprintf('rspStr: '); 
-                    fprintf('%c',rspStrJson);
-                    fprintf('\n');
-                end
+                % Get response as json string and parse. Events sent by the
+                % device ahead of the response are saved and skipped.
+                while true
+                    rspStrJson = fscanf(obj.dev,'%c');
+                    if obj.debug
+                        fprintf('rspStr: '); 
+                        fprintf('%c',rspStrJson);
+                        fprintf('\n');
+                    end
 
-                try
-                    rspStruct = loadjson(rspStrJson);
-                catch ME
-                    causeME = MException( ... 
-                        'FlyHerderSerial:unableToPaseJSON', ... 
-                        'Unable to parse device response' ...
-                        );
-                    ME = addCause(ME, causeME); 
-                    rethrow(ME);
+                    try
+                        rspStruct = loadjson(rspStrJson);
+                    catch ME
+                        causeME = MException( ... 
+                            'FlyHerderSerial:unableToPaseJSON', ... 
+                            'Unable to parse device response' ...
+                            );
+                        ME = addCause(ME, causeME); 
+                        rethrow(ME);
+                    end
+                    if isfield(rspStruct,'event')
+                        obj.eventCell{end+1} = rspStruct.event;
+                    else
+                        break;
+                    end
                 end
 
                 % Check the returned cmd Id 
@@ -501,6 +745,47 @@ classdef FlyHerderSerial < handle
 
     methods (Access=private)
 
+        function waitReady(obj)
+            % waitReady - waits for the ready banner sent by the device at the
+            % end of its setup, after the reset caused by opening the port. 
+            % Anything else received in the meantime is discarded.
+            t0 = tic;
+            while toc(t0) < obj.readyTimeout
+                if get(obj.dev,'BytesAvailable') == 0
+                    pause(obj.readyPauseDt);
+                    continue;
+                end
+                rspStrJson = fgetl(obj.dev);
+                try
+                    rspStruct = loadjson(rspStrJson);
+                catch ME
+                    continue;
+                end
+                if isfield(rspStruct,'event') && strcmp(rspStruct.event,'ready')
+                    obj.readyStruct = rspStruct;
+                    return;
+                end
+            end
+        end
+
+        function waitDriveReady(obj)
+            % waitDriveReady - waits until the device reports the drive ready
+            % after power on.
+            t0 = tic;
+            while true
+                rsp = obj.sendCmd(obj.cmdIdStruct.isDriveReady);
+                if rsp.isDriveReady
+                    break;
+                end
+                if toc(t0) > obj.powerOnTimeout
+                    msg = sprintf('drive not ready %1.1f s after power on', obj.powerOnTimeout);
+                    ME = MException('FlyHerderSerial:driveNotReady', msg);
+                    throw(ME);
+                end
+                pause(obj.readyPauseDt);
+            end
+        end
+
         function cmdStr = createCmdStr(obj, cmdId, cmdArgs) 
             % createCmdStr - create a command string for sending to the device given
             % the cmdId number and a cell array of the commands arguments.
@@ -549,16 +834,16 @@ classdef FlyHerderSerial < handle
             end
             cmdId = obj.cmdIdStruct.(cmdName);
             % Convert command arguments from structure if required
-            if length(cmdArgs) == 1 && strcmp(class(cmdArgs{1}), 'struct')
-                cmdArgs = obj.convertArgStructToCell(cmdArgs{1});
+            if length(cmdArgs) >= 1 && strcmp(class(cmdArgs{1}), 'struct')
+                cmdArgs = [obj.convertArgStructToCell(cmdArgs{1}), cmdArgs(2:end)];
             end
 
             % Send command and get response
             rspStruct = obj.sendCmd(cmdId,cmdArgs{:});
 
-            % If is setDrivePowerOn command pause pause to let drive wake up.
+            % If is setDrivePowerOn command wait until the drive is ready.
             if strcmp(cmdName,'setDrivePowerOn')
-                pause(obj.powerOnDelay);
+                obj.waitDriveReady();
             end
 
             % Convert response into return value.
@@ -0,0 +1,34 @@
+from __future__ import print_function
+import sys
+from flyherder_serial import FlyHerderGroup
+
+portList = ['/dev/ttyUSB0', '/dev/ttyUSB1']
+group = FlyHerderGroup(portList,timeout=2.0)
+
+moveSpeed = 30.0
+posList = [
+        {'x0':50.0, 'y0':50.0, 'x1':150.0, 'y1':150.0},
+        {'x0':60.0, 'y0':40.0, 'x1':160.0, 'y1':140.0},
+        ]
+
+group.setDrivePowerOn()
+group.setSpeed(moveSpeed)
+
+print('homing ... ', end='')
+sys.stdout.flush()
+group.moveToHome()
+group.wait()
+print('done')
+
+print('moving to start position ... ', end='')
+sys.stdout.flush()
+group.armMove(posList)
+skew = group.startArmed()
+group.wait()
+print('done, start skew {0:1.1f} ms'.format(1.0e3*skew))
+
+for i, posDict in enumerate(group.getPosition()):
+    print('  {0}: {1}'.format(portList[i], posDict))
+
+group.setDrivePowerOff()
+group.close()
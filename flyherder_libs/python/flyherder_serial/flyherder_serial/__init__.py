@@ -1 +1,3 @@
 from flyherder_serial import FlyHerder
+from flyherder_group import FlyHerderGroup
+from position_sampler import PositionSampler
@@ -0,0 +1,129 @@
+from __future__ import print_function
+import time
+import threading
+from flyherder_serial import FlyHerder
+
+class FlyHerderGroup(object):
+    """
+    A group of FlyHerder devices, one per arena, driven together. Commands
+    are sent to all devices concurrently, one thread per device, so that the
+    time taken is that of the slowest device rather than the sum.
+
+    Synchronized moves are made in two steps. armMove loads the move into 
+    each device without starting it, then startArmed sends the single byte 
+    start code to all devices back to back. 
+
+    Example:
+
+        group = FlyHerderGroup(['/dev/ttyUSB0', '/dev/ttyUSB1'])
+        group.setDrivePowerOn()
+        group.armMove([posDict0, posDict1])
+        skew = group.startArmed()
+        group.wait()
+    """
+
+    def __init__(self,portList,**kwargs):
+        self.portList = list(portList)
+        openList = self.runAll(self.openDevice,[(port,kwargs) for port in self.portList])
+        self.devList = openList
+
+    def openDevice(self,port,kwargs):
+        return FlyHerder(port=port,**kwargs)
+
+    def close(self):
+        for dev in self.devList:
+            dev.close()
+
+    def __len__(self):
+        return len(self.devList)
+
+    def __getitem__(self,index):
+        return self.devList[index]
+
+    def runAll(self,func,argsList):
+        """
+        Calls func(*args) for each entry of argsList, concurrently, and returns
+        the list of return values. If any call raises an exception the first 
+        one, in device order, is raised once all calls have finished.
+        """
+        rtnList = [None]*len(argsList)
+        errList = [None]*len(argsList)
+        def target(i,args):
+            try:
+                rtnList[i] = func(*args)
+            except Exception, e:
+                errList[i] = e
+        threadList = []
+        for i, args in enumerate(argsList):
+            thread = threading.Thread(target=target,args=(i,args))
+            thread.daemon = True
+            thread.start()
+            threadList.append(thread)
+        for thread in threadList:
+            thread.join()
+        for i, err in enumerate(errList):
+            if err is not None:
+                raise IOError, '{0}: {1}'.format(self.getPort(i),str(err))
+        return rtnList
+
+    def getPort(self,i):
+        try:
+            return self.portList[i]
+        except IndexError:
+            return 'device {0}'.format(i)
+
+    def sendAll(self,cmdName,*args):
+        """
+        Sends the same command, with the same arguments, to all devices and 
+        returns the list of results.
+        """
+        return self.runAll(lambda dev: getattr(dev,cmdName)(*args), [(dev,) for dev in self.devList])
+
+    def sendEach(self,cmdName,argsList):
+        """
+        Sends a command to each device with its own arguments - argsList has 
+        an entry, a tuple of arguments, per device.
+        """
+        if len(argsList) != len(self.devList):
+            raise ValueError, 'argsList must have one entry per device'
+        return self.runAll(
+                lambda dev, args: getattr(dev,cmdName)(*args), 
+                zip(self.devList,argsList)
+                )
+
+    def __getattr__(self,name):
+        # Any other device command is sent to all devices
+        if name.startswith('__') or name in ('devList', 'portList'):
+            raise AttributeError, name
+        return lambda *args: self.sendAll(name,*args)
+
+    def armMove(self,posList):
+        """
+        Loads a move to posList[i], a position dictionary keyed by axis name,
+        into device i. The moves are started with startArmed.
+        """
+        return self.sendEach('armMove',[(pos,) for pos in posList])
+
+    def startArmed(self):
+        """
+        Starts the armed moves on all devices. The start byte is written to 
+        each port back to back and the devices act on it in the serial 
+        receive interrupt. Returns the measured skew (s), the time from just 
+        before the first write to just after the last.
+        """
+        t0 = time.time()
+        for dev in self.devList:
+            dev.write(FlyHerder.START_ARMED_BYTE)
+        t1 = time.time()
+        for dev in self.devList:
+            dev.flush()
+        return t1 - t0
+
+    def wait(self):
+        self.sendAll('wait')
+
+    def emergencyStop(self):
+        for dev in self.devList:
+            dev.write(FlyHerder.EMERGENCY_STOP_BYTE)
+        for dev in self.devList:
+            dev.flush()
@@ -8,8 +8,14 @@ class FlyHerder(SerialDevice):
     BAUDRATE = 9600 
     TIMEOUT = 8.0
     DEVICE_MODEL_NUMBER = 1105
-    POWER_ON_SLEEP_T = 1.0
+    POWER_ON_TIMEOUT = 5.0
     WAIT_SLEEP_DT = 0.2
+    READY_SLEEP_DT = 0.02
+    POSITION_MODES = ('float', 'steps')
+    EMERGENCY_STOP_BYTE = '\x03'
+    FEED_OVERRIDE_BYTE = '\x04'
+    START_ARMED_BYTE = '\x05'
+    FEED_OVERRIDE_RANGE = (10, 200)
 
     def __init__(self,*args,**kwargs):
         kwargs.update({
@@ -26,29 +32,99 @@ class FlyHerder(SerialDevice):
         self.axisNameSet = set(self.getAxisNames())
         self.axisOrderDict = self.getAxisOrder()
         self.dimOrderDict = self.getDimOrder()
+        self.positionMode = 'float'
+        self.stepsPerMM = None
 
     def wait(self):
         while self.isRunning():
             time.sleep(FlyHerder.WAIT_SLEEP_DT)
 
+    def emergencyStop(self):
+        """
+        Stops all motion immediately. Sends the single byte emergency stop
+        code, which the device acts on as soon as it is received, even in the
+        middle of a command. Commands sent before it that have not yet run
+        are discarded, and moves are refused until the device has sent the
+        'emergencyStop' event, see getEvents. Does not wait for a response.
+        """
+        self.write(FlyHerder.EMERGENCY_STOP_BYTE)
+        self.flush()
+
+    def startArmed(self):
+        """
+        Starts the move loaded with armMove. Sent as a fast path command - the
+        device starts the move as soon as the byte is received and there is 
+        no response. See FlyHerderGroup for starting several devices together.
+        """
+        self.write(FlyHerder.START_ARMED_BYTE)
+        self.flush()
+
+    def setFeedOverride(self,percent):
+        """
+        Sets the feed override (%), which scales the speed of all moves 
+        including the one in progress. The device ramps to the new value 
+        rather than jumping. Sent as a fast path command - there is no 
+        response. Use getFeedOverride to read back the current value.
+        """
+        percent = int(percent)
+        minPercent, maxPercent = FlyHerder.FEED_OVERRIDE_RANGE
+        if percent < minPercent or percent > maxPercent:
+            errMsg = 'feed override must be in range {0} to {1}'.format(minPercent,maxPercent)
+            raise ValueError, errMsg
+        self.write(FlyHerder.FEED_OVERRIDE_BYTE + chr(percent))
+        self.flush()
+
+    def waitDriveReady(self,timeout=POWER_ON_TIMEOUT):
+        """
+        Waits until the device reports the drive ready after power on, i.e.,
+        until the drive power has settled and the fault input is clear.
+        """
+        t0 = time.time()
+        while not self.cmdFuncDict['isDriveReady']():
+            if time.time() - t0 > timeout:
+                errMsg = 'drive not ready {0} s after power on'.format(timeout)
+                raise IOError, errMsg
+            time.sleep(FlyHerder.READY_SLEEP_DT)
+
+    def restoreOrHome(self,acceptStale=False):
+        """
+        Uses the axis positions the device restored from EEPROM at startup, 
+        unless they are stale - the axes started moving after they were saved
+        - and acceptStale is False, otherwise homes the axes. Returns True if 
+        the axes were homed. Homing needs the drive powered on.
+        """
+        rsp = self.cmdFuncDict['getStoredPosition']()
+        if rsp['restored'] and (acceptStale or not rsp['stale']):
+            self.cmdFuncDict['acceptStoredPosition']()
+            return False
+        if rsp['restored']:
+            self.cmdFuncDict['rejectStoredPosition']()
+        self.cmdFuncDict['moveToHome']()
+        self.wait()
+        return True
+
     def cmdFuncBase(self,cmdName,*args):
-        if len(args) == 1 and type(args[0]) is dict:
+        if len(args) >= 1 and type(args[0]) is dict:
             argsDict = args[0]
             argsList = self.argsDictToList(argsDict)
+            argsList.extend(args[1:])
         else:
             argsList = args
         rspDict = self.sendCmdByName(cmdName,*argsList)
         if cmdName == 'setDrivePowerOn':
-            time.sleep(FlyHerder.POWER_ON_SLEEP_T)
+            self.waitDriveReady()
         if rspDict:
             retValue = self.processRspDict(rspDict)
             return retValue
 
     def createCmds(self):
+        # Commands which have a wrapper method in the class are only added to
+        # cmdFuncDict. 
         self.cmdFuncDict = {}
         for cmdId, cmdName in sorted(self.cmdDictInv.items()):
             cmdFunc = functools.partial(self.cmdFuncBase, cmdName)
-            setattr(self,cmdName,cmdFunc)
+            if not hasattr(FlyHerder,cmdName):
+                setattr(self,cmdName,cmdFunc)
             self.cmdFuncDict[cmdName] = cmdFunc
 
     def printCommands(self):
@@ -70,6 +146,48 @@ class FlyHerder(SerialDevice):
                 retValue = rspDict
         return retValue
 
+    def setPositionMode(self,mode):
+        """
+        Sets how getPosition and getAxisPosition get the position from the
+        device. In 'float' mode the device converts the position to mm. In 
+        'steps' mode the device sends the position in steps and the conversion
+        to mm is done here using a cached copy of the device's stepsPerMM. The
+        'steps' replies are shorter and faster for polling loops. 
+        """
+        if not mode in FlyHerder.POSITION_MODES:
+            raise ValueError, 'unknown position mode {0}'.format(mode)
+        if mode == 'steps' and not 'getPositionSteps' in self.cmdDict:
+            raise ValueError, 'device does not support steps position mode'
+        self.positionMode = mode
+
+    def getPositionMode(self):
+        return self.positionMode
+
+    def getPosition(self):
+        if self.positionMode == 'steps':
+            posDict = self.cmdFuncDict['getPositionSteps']()
+            return dict([(k,self.convertStepsToMM(v)) for (k,v) in posDict.iteritems()])
+        return self.cmdFuncDict['getPosition']()
+
+    def getAxisPosition(self,axisName):
+        if self.positionMode == 'steps':
+            pos = self.cmdFuncDict['getAxisPositionSteps'](axisName)
+            return self.convertStepsToMM(pos)
+        return self.cmdFuncDict['getAxisPosition'](axisName)
+
+    def setStepsPerMM(self,*args):
+        self.stepsPerMM = None
+        return self.cmdFuncDict['setStepsPerMM'](*args)
+
+    def getStepsPerMM(self):
+        self.stepsPerMM = self.cmdFuncDict['getStepsPerMM']()
+        return self.stepsPerMM
+
+    def convertStepsToMM(self,steps):
+        if self.stepsPerMM is None:
+            self.getStepsPerMM()
+        return float(steps)/self.stepsPerMM
+
     def argsDictToList(self,argsDict): 
         keySet = set(argsDict.keys())
         if keySet == self.dimNameSet: 
@@ -0,0 +1,176 @@
+from __future__ import print_function
+import time
+import threading
+import Queue
+import numpy
+
+class PositionSampler(object):
+    """
+    Samples the position of a FlyHerder device continuously on a background 
+    thread and keeps the samples in a preallocated NumPy ring buffer. Each 
+    sample is a row (host time (s), x0, y0, x1, y1) with the positions in mm 
+    and the time taken halfway between sending the request and receiving the
+    reply.
+
+    While the sampler is running it owns the serial port. Device commands are
+    sent through the sampler - they are queued and sent between samples:
+
+        sampler = PositionSampler(dev)
+        sampler.start()
+        sampler.moveToPosition(pos)     # any FlyHerder method
+        sampler.wait()
+        samples = sampler.getLast(500)
+        sampler.stop()
+
+    Samples are taken as fast as the serial link allows, or at most every
+    period seconds if a period is given. The positions are read in steps,
+    which gives the shortest replies, and converted using the device's 
+    stepsPerMM.
+    """
+
+    BUFFER_SIZE = 100000
+    WAIT_SLEEP_DT = 0.05
+
+    def __init__(self,dev,size=BUFFER_SIZE,period=0.0):
+        self.dev = dev
+        self.size = size
+        self.period = period
+        axisOrder = dev.getAxisOrder()
+        self.axisNames = [name for (num,name) in sorted([(v,k) for (k,v) in axisOrder.iteritems()])]
+        self.stepsPerMM = dev.getStepsPerMM()
+        # Each sample is written twice, at i and i+size, so that the last n 
+        # samples are always a contiguous slice of the buffer.
+        self.buffer = numpy.zeros((2*size,1+len(self.axisNames)))
+        self.count = 0
+        self.requestQueue = Queue.Queue()
+        self.stopEvent = threading.Event()
+        self.thread = None
+        self.error = None
+
+    def __enter__(self):
+        self.start()
+        return self
+
+    def __exit__(self,excType,excValue,traceback):
+        self.stop()
+
+    def start(self):
+        if self.isRunning():
+            return
+        self.stopEvent.clear()
+        self.error = None
+        self.thread = threading.Thread(target=self.run)
+        self.thread.daemon = True
+        self.thread.start()
+
+    def stop(self):
+        if self.thread is not None:
+            self.stopEvent.set()
+            self.thread.join()
+            self.thread = None
+        self.checkError()
+
+    def isRunning(self):
+        return self.thread is not None and self.thread.is_alive()
+
+    def clear(self):
+        self.count = 0
+
+    def getCount(self):
+        """
+        Returns the number of samples taken since start or clear, including
+        those since overwritten.
+        """
+        return self.count
+
+    def getLast(self,n=None):
+        """
+        Returns a view of the last n samples, oldest first, as an n x 5 array.
+        The view is not a copy - samples older than the buffer size are 
+        overwritten as sampling continues, so copy it if it is kept.
+        """
+        count = self.count
+        if n is None:
+            n = self.size
+        n = min(n,count,self.size)
+        end = (count - 1)%self.size + self.size + 1
+        view = self.buffer[end-n:end]
+        view.flags.writeable = False
+        return view
+
+    def call(self,cmdName,*args):
+        """
+        Calls a device method from the sampling thread, between samples, and 
+        returns its result. Exceptions are raised in the caller.
+        """
+        if not self.isRunning():
+            self.checkError()
+            return getattr(self.dev,cmdName)(*args)
+        request = {'name': cmdName, 'args': args, 'done': threading.Event()}
+        self.requestQueue.put(request)
+        while not request['done'].wait(PositionSampler.WAIT_SLEEP_DT):
+            if not self.isRunning():
+                self.checkError()
+                raise IOError, 'sampler stopped'
+        if 'error' in request:
+            raise request['error']
+        return request['rtn']
+
+    def __getattr__(self,name):
+        # Any other device command is sent through the sampling thread
+        if name.startswith('__') or name in ('dev', 'thread'):
+            raise AttributeError, name
+        return lambda *args: self.call(name,*args)
+
+    def wait(self):
+        # Waits for the device to stop, polling isRunning between samples
+        while self.call('isRunning'):
+            time.sleep(PositionSampler.WAIT_SLEEP_DT)
+
+    def checkError(self):
+        if self.error is not None:
+            error = self.error
+            self.error = None
+            raise error
+
+    def run(self):
+        getPositionSteps = self.dev.cmdFuncDict['getPositionSteps']
+        tLast = 0.0
+        try:
+            while not self.stopEvent.is_set():
+                self.processRequests()
+                if self.period > 0.0:
+                    dt = tLast + self.period - time.time()
+                    if dt > 0.0:
+                        time.sleep(min(dt,PositionSampler.WAIT_SLEEP_DT))
+                        continue
+                t0 = time.time()
+                posDict = getPositionSteps()
+                t1 = time.time()
+                tLast = t0
+                self.addSample(0.5*(t0 + t1),posDict)
+        except Exception, e:
+            self.error = e
+
+    def processRequests(self):
+        while True:
+            try:
+                request = self.requestQueue.get_nowait()
+            except Queue.Empty:
+                return
+            try:
+                request['rtn'] = getattr(self.dev,request['name'])(*request['args'])
+                if request['name'] == 'setStepsPerMM':
+                    self.stepsPerMM = self.dev.getStepsPerMM()
+            except Exception, e:
+                request['error'] = e
+            request['done'].set()
+
+    def addSample(self,t,posDict):
+        i = self.count%self.size
+        row = self.buffer[i]
+        row[0] = t
+        for j, name in enumerate(self.axisNames):
+            row[j+1] = float(posDict[name])/self.stepsPerMM
+        self.buffer[i+self.size] = row
+        self.count += 1
@@ -3,45 +3,174 @@ import os
 import serial
 import time
 import json
+import termios
+import fcntl
+import array
 import functools
+import binascii
 
 class SerialDevice(serial.Serial):
 
     CMD_GET_DEV_INFO = 0
     CMD_GET_CMDS = 1
     CMD_GET_RSP_CODES = 2
-    RESET_SLEEP_T = 2.0
+    READY_TIMEOUT = 3.0
+    READY_READ_TIMEOUT = 0.05
+    PROBE_TIMEOUT = 0.25
+    RESET_PULSE_T = 0.05
+    READ_CHUNK_SIZE = 256
+    LATENCY_TIMER_MS = 1
+    TIOCGSERIAL = 0x541E
+    TIOCSSERIAL = 0x541F
+    ASYNC_LOW_LATENCY = 0x2000
+    FRAME_RETRIES = 3
+    FRAME_START = '#'
+    FRAME_NAK = '#!'
 
     def __init__(self, *args, **kwargs):
+        """
+        Opens the port and waits for the ready banner the device sends at the
+        end of its setup. With reset=False the device is not reset when it is
+        already running, and DTR is left asserted when the port is closed so
+        that later opens do not reset it either.
+
+        With lowLatency=True the port is set up for the shortest round trip:
+        the kernel's ASYNC_LOW_LATENCY flag and, for FTDI adapters, a 1 ms 
+        latency timer are set where the driver and permissions allow, and 
+        replies are read in bulk chunks and split into lines here rather 
+        than a byte at a time. See lowLatencyDict for which settings took.
+
+        With framed=True every command and reply carries a sequence number 
+        and CRC-16, and a command whose reply is corrupted, lost or refused 
+        by the device is sent again, up to frameRetries times. The device 
+        answers a repeated command from the reply it kept rather than running
+        it twice. Lost replies are only detected with a read timeout set.
+        """
         try:
             debug = kwargs.pop('debug')
         except KeyError:
             debug = False 
+        try:
+            reset = kwargs.pop('reset')
+        except KeyError:
+            reset = True
+        try:
+            readyTimeout = kwargs.pop('readyTimeout')
+        except KeyError:
+            readyTimeout = SerialDevice.READY_TIMEOUT
+        try:
+            lowLatency = kwargs.pop('lowLatency')
+        except KeyError:
+            lowLatency = False
+        try:
+            framed = kwargs.pop('framed')
+        except KeyError:
+            framed = False
+        try:
+            frameRetries = kwargs.pop('frameRetries')
+        except KeyError:
+            frameRetries = SerialDevice.FRAME_RETRIES
+        self.lowLatency = False
+        self.rxBuf = ''
+        self.framed = framed
+        self.frameRetries = frameRetries
+        self.frameSeq = 0
+        self.resetFrameStats()
         super(SerialDevice,self).__init__(*args,**kwargs)
-        time.sleep(SerialDevice.RESET_SLEEP_T)
+        self.cmdTimeDict = {}
+        self.lowLatencyDict = {}
+        if lowLatency:
+            self.setLowLatency()
         self.deviceInfoDict = None
         self.rspDict = None
         self.cmdDict = None
+        self.readyDict = None
+        self.eventList = []
         self.debug = debug
+        if reset:
+            self.resetDevice()
+            self.waitReady(readyTimeout)
+        else:
+            self.setHangupOnClose(False)
+            if not self.probeDevice():
+                self.waitReady(readyTimeout)
 
     def debugPrint(self, *args):
         if self.debug:
             print(*args)
 
+    def setLowLatency(self):
+        """
+        Enables low latency mode. Sets ASYNC_LOW_LATENCY on the port and the 
+        USB serial adapter's latency timer where possible - either may fail, 
+        e.g. on a pty or without write access to sysfs, and the result is
+        recorded in lowLatencyDict. Reads then go through readFrame's bulk
+        reads.
+        """
+        self.lowLatency = True
+        self.lowLatencyDict = {
+                'asyncLowLatency': self.setAsyncLowLatency(), 
+                'latencyTimer': self.setLatencyTimer(SerialDevice.LATENCY_TIMER_MS),
+                }
+        return self.lowLatencyDict
+
+    def setAsyncLowLatency(self):
+        buf = array.array('i', [0]*32)
+        try:
+            fcntl.ioctl(self.fd, SerialDevice.TIOCGSERIAL, buf)
+            buf[4] |= SerialDevice.ASYNC_LOW_LATENCY
+            fcntl.ioctl(self.fd, SerialDevice.TIOCSSERIAL, buf)
+        except IOError:
+            return False
+        return True
+
+    def setLatencyTimer(self,value):
+        name = os.path.basename(os.path.realpath(self.port))
+        path = os.path.join('/sys/bus/usb-serial/devices',name,'latency_timer')
+        try:
+            with open(path,'w') as f:
+                f.write(str(value))
+        except (IOError, OSError):
+            return False
+        return True
+
+    def readFrame(self):
+        """
+        Reads one line from the device. In low latency mode everything 
+        available is read in one call and split into lines here, with any 
+        following lines kept for the next call. Returns what has been received
+        so far if the timeout expires first, like readline.
+        """
+        if not self.lowLatency:
+            return self.readline()
+        t0 = time.time()
+        while True:
+            n = self.rxBuf.find('\n')
+            if n >= 0:
+                line = self.rxBuf[:n+1]
+                self.rxBuf = self.rxBuf[n+1:]
+                return line
+            if self.timeout is not None and time.time() - t0 >= self.timeout:
+                line = self.rxBuf
+                self.rxBuf = ''
+                return line
+            num = min(max(1,self.inWaiting()),SerialDevice.READ_CHUNK_SIZE)
+            self.rxBuf += self.read(num)
+
+    def flushInput(self):
+        self.rxBuf = ''
+        super(SerialDevice,self).flushInput()
+
     def sendCmd(self,*args):
         cmdList = ['[', ','.join(map(str,args)), ']']
         cmd = ''.join(cmdList)
         self.debugPrint('cmd', cmd)
-        self.write(cmd)
-
-        rspStr = self.readline()
-        self.debugPrint('rspStr', rspStr)
-        try:
-            rspDict = jsonStrToDict(rspStr)
-        except Exception, e:
-            errMsg = 'unable to parse device response {0}'.format(str(e))
-            self.flush()
-            raise IOError, errMsg
+        t0 = time.time()
+        if self.framed:
+            rspDict = self.sendFramedCmd(cmd)
+        else:
+            self.write(cmd)
+            rspDict = self.readRsp()
         try:
             status = rspDict.pop('status')
         except KeyError:
@@ -54,6 +183,7 @@ class SerialDevice(serial.Serial):
             raise IOError, errMsg
         if not rspCmdId == args[0]:
             raise IOError, 'device response cmdId does not match that sent'
+        self.addCmdTime(rspCmdId,time.time() - t0)
         if self.rspDict is not None:
             if status == self.rspDict['rspError']:
                 try:
@@ -64,6 +194,191 @@ class SerialDevice(serial.Serial):
                 raise IOError, errMsg
         return rspDict
 
+    def readRsp(self):
+        # Events sent by the device ahead of the response are saved and
+        # skipped.
+        while True:
+            rspStr = self.readFrame()
+            self.debugPrint('rspStr', rspStr)
+            try:
+                rspDict = jsonStrToDict(rspStr)
+            except Exception, e:
+                errMsg = 'unable to parse device response {0}'.format(str(e))
+                self.flush()
+                raise IOError, errMsg
+            if 'event' in rspDict:
+                self.eventList.append(rspDict['event'])
+            else:
+                return rspDict
+
+    def sendFramedCmd(self,cmd):
+        """
+        Sends a command framed with the next sequence number and returns the
+        response. The same frame is sent again when the device refuses it or
+        no valid response arrives. Sequence numbers run from 1 to 255 after 
+        the first command, which is sent with 0 so that it is never taken 
+        for a repeat of a command from before the port was opened.
+        """
+        seq = self.frameSeq
+        self.frameSeq = self.frameSeq % 255 + 1
+        frame = frameCmd(seq,cmd)
+        for i in range(self.frameRetries+1):
+            if i > 0:
+                self.frameStats['retries'] += 1
+            self.write(frame)
+            rspDict = self.readFramedRsp(seq)
+            if rspDict is not None:
+                return rspDict
+        errMsg = 'no valid device response after {0} tries'.format(i+1)
+        raise IOError, errMsg
+
+    def readFramedRsp(self,seq):
+        # Returns None if the frame should be sent again. Responses with 
+        # another sequence number are left over from earlier tries and are
+        # skipped, as are unframed lines other than events.
+        while True:
+            rspStr = self.readFrame()
+            self.debugPrint('rspStr', rspStr)
+            if not rspStr.endswith('\n'):
+                self.frameStats['timeouts'] += 1
+                return None
+            rspStr = rspStr.strip()
+            if rspStr == SerialDevice.FRAME_NAK:
+                self.frameStats['nak'] += 1
+                return None
+            if rspStr.startswith(SerialDevice.FRAME_START):
+                try:
+                    rspSeq, payload = parseFrame(rspStr)
+                except ValueError:
+                    self.frameStats['crcErrors'] += 1
+                    return None
+                if rspSeq == seq:
+                    try:
+                        return jsonStrToDict(payload)
+                    except Exception, e:
+                        errMsg = 'unable to parse device response {0}'.format(str(e))
+                        raise IOError, errMsg
+            else:
+                try:
+                    rspDict = jsonStrToDict(rspStr)
+                except Exception:
+                    continue
+                if 'event' in rspDict:
+                    self.eventList.append(rspDict['event'])
+
+    def resetFrameStats(self):
+        """
+        Clears the counts of framed commands sent again (retries) and of the
+        reasons why - refused by the device (nak), a response failing its
+        check (crcErrors) or no response in time (timeouts).
+        """
+        self.frameStats = {'retries': 0, 'nak': 0, 'crcErrors': 0, 'timeouts': 0}
+
+    def resetDevice(self):
+        """
+        Resets the device by pulsing DTR. Opening the port only resets the
+        device if DTR was dropped when it was last closed.
+        """
+        self.setDTR(False)
+        time.sleep(SerialDevice.RESET_PULSE_T)
+        self.flushInput()
+        self.setDTR(True)
+
+    def waitReady(self,timeout=READY_TIMEOUT):
+        """
+        Waits for the ready banner sent by the device at the end of its setup.
+        Returns True when it is received, False if the timeout expires first.
+        Anything else received in the meantime, e.g. output from the boot
+        loader, is discarded.
+        """
+        oldTimeout = self.timeout
+        self.timeout = SerialDevice.READY_READ_TIMEOUT
+        t0 = time.time()
+        try:
+            while time.time() - t0 < timeout:
+                rspStr = self.readFrame()
+                if not rspStr:
+                    continue
+                self.debugPrint('rspStr', rspStr)
+                try:
+                    rspDict = jsonStrToDict(rspStr)
+                except Exception:
+                    continue
+                if rspDict.get('event') == 'ready':
+                    self.readyDict = rspDict
+                    return True
+        finally:
+            self.timeout = oldTimeout
+        self.debugPrint('ready banner not received')
+        return False
+
+    def probeDevice(self):
+        """
+        Returns True if the device is running and answers the get device info
+        command within PROBE_TIMEOUT.
+        """
+        oldTimeout = self.timeout
+        self.timeout = SerialDevice.PROBE_TIMEOUT
+        self.flushInput()
+        try:
+            self.write('[{0}]'.format(SerialDevice.CMD_GET_DEV_INFO))
+            while True:
+                rspStr = self.readFrame()
+                if not rspStr:
+                    return False
+                try:
+                    rspDict = jsonStrToDict(rspStr)
+                except Exception:
+                    continue
+                if rspDict.get('cmdId') == SerialDevice.CMD_GET_DEV_INFO:
+                    return True
+        finally:
+            self.timeout = oldTimeout
+
+    def setHangupOnClose(self,value):
+        """
+        Sets whether DTR is dropped when the port is closed. Dropping DTR
+        resets the device the next time the port is opened.
+        """
+        attrs = termios.tcgetattr(self.fd)
+        if value:
+            attrs[2] |= termios.HUPCL
+        else:
+            attrs[2] &= ~termios.HUPCL
+        termios.tcsetattr(self.fd,termios.TCSANOW,attrs)
+
+    def addCmdTime(self,cmdId,dt):
+        try:
+            stats = self.cmdTimeDict[cmdId]
+        except KeyError:
+            stats = {'count': 0, 'total': 0.0, 'min': dt, 'max': dt}
+            self.cmdTimeDict[cmdId] = stats
+        stats['count'] += 1
+        stats['total'] += dt
+        stats['min'] = min(stats['min'],dt)
+        stats['max'] = max(stats['max'],dt)
+
+    def getCmdTimeStats(self):
+        """
+        Returns the round trip time statistics (s) - count, mean, min and max
+        - of each command sent, keyed by command name where known.
+        """
+        nameDict = {}
+        if self.cmdDict is not None:
+            nameDict = dict([(v,k) for (k,v) in self.cmdDict.iteritems()])
+        statsDict = {}
+        for cmdId, stats in self.cmdTimeDict.iteritems():
+            statsDict[nameDict.get(cmdId,cmdId)] = {
+                    'count': stats['count'],
+                    'mean': stats['total']/stats['count'],
+                    'min': stats['min'],
+                    'max': stats['max'],
+                    }
+        return statsDict
+
+    def resetCmdTimeStats(self):
+        self.cmdTimeDict = {}
+
     def getDeviceInfoDict(self):
         infoDict = self.sendCmd(SerialDevice.CMD_GET_DEV_INFO)
         checkDictForKey(infoDict,'ModelNumber',dname='infoDict')
@@ -80,6 +395,15 @@ class SerialDevice(serial.Serial):
         checkDictForKey(rspDict,'rspError',dname='rspDict')
         return rspDict
 
+    def getEvents(self):
+        """
+        Returns the list of events received from the device since the last
+        call and clears it.
+        """
+        eventList = self.eventList
+        self.eventList = []
+        return eventList
+
     def sendCmdByName(self,name,*args):
         cmdId = self.cmdDict[name]
         cmdArgs = [cmdId]
@@ -145,6 +469,27 @@ def checkDictForKey(d,k,dname=''):
             dname = 'dictionary'
         raise IOError, '{0} does not contain {1}'.format(dname,k)
 
+def frameCrc(data):
+    # CRC-16, polynomial 0x1021, initial value 0xffff - the same as the
+    # firmware's FrameLink
+    return binascii.crc_hqx(data,0xffff)
+
+def frameCmd(seq,cmd):
+    body = '{0:02X}{1}'.format(seq,cmd)
+    return '{0}{1}*{2:04X}\n'.format(SerialDevice.FRAME_START,body,frameCrc(body))
+
+def parseFrame(frame):
+    """
+    Returns the sequence number and payload of a framed response, #SS...*CCCC.
+    Raises ValueError if the frame is malformed or fails its CRC check.
+    """
+    if len(frame) < 8 or frame[0] != SerialDevice.FRAME_START or frame[-5] != '*':
+        raise ValueError, 'malformed frame'
+    body = frame[1:-5]
+    if int(frame[-4:],16) != frameCrc(body):
+        raise ValueError, 'frame crc mismatch'
+    return int(body[:2],16), body[2:]
+
 def jsonStrToDict(jsonStr): 
     jsonDict =  json.loads(jsonStr,object_hook=jsonDecodeDict) 
     return jsonDict
@@ -25,5 +25,5 @@ setup(
     license='LICENSE.txt',
     description="Serial interface for IO Rodeo's FlyHerder.",
     long_description=open('README.txt').read(),
-    install_requires= [],
+    install_requires= ['numpy'],
 )
@@ -1,5 +1,5 @@
 from __future__ import print_function
-from flyherder_serial import FlyHerder
+from flyherder_serial import FlyHerder, PositionSampler
 from pprint import pprint
 
 TEST_FLOAT_PREC = 1.0e-6
@@ -12,6 +12,14 @@ def test_getDevInfo():
     print('\ndev.getDevInfo() = ')
     pprint(rsp)
 
+def test_readyBanner():
+    print('\ndev.readyDict = ')
+    pprint(dev.readyDict)
+    assert dev.readyDict is not None
+    assert dev.readyDict['modelNumber'] == FlyHerder.DEVICE_MODEL_NUMBER
+    rsp = dev.getDevInfo()
+    assert rsp['Firmware'] == dev.readyDict['firmware']
+
 def test_getCmds():
     rsp = dev.getCmds()
     print('\ndev.getCmds() = ')
@@ -81,9 +89,34 @@ def test_isDrivePowerOn():
     rsp = dev.isDrivePowerOn()
     assert rsp in (0,1)
 
+def test_isDriveReady():
+    rsp = dev.isDriveReady()
+    assert rsp in (0,1)
+    if dev.isDrivePowerOn():
+        assert rsp == 1
+
+def test_getFaultStatus():
+    rsp = dev.getFaultStatus()
+    print('\ndev.getFaultStatus() = ')
+    pprint(rsp)
+    assert rsp['fault'] in (0,1)
+    assert rsp['faultInput'] in (0,1)
+
+def test_clearFault():
+    rsp = dev.getFaultStatus()
+    if not rsp['faultInput']:
+        dev.clearFault()
+        rsp = dev.getFaultStatus()
+        assert rsp['fault'] == 0
+
 def test_stop(): 
     dev.stop()
 
+def test_emergencyStop():
+    dev.emergencyStop()
+    assert dev.isRunning() == 0
+    assert 'emergencyStop' in dev.getEvents()
+
 def test_isRunning():
     rsp = dev.isRunning()
     assert rsp in (0,1)
@@ -120,11 +153,94 @@ def test_moveToPosition():
     posDict = {'x0':2.0, 'y0': 3.0, 'x1':4.0, 'y1':5.0}
     dev.moveToPosition(posDict)
 
+def test_armMove():
+    dev.wait()
+    posDict = {'x0':3.0, 'y0': 4.0, 'x1':5.0, 'y1':6.0}
+    dev.armMove(posDict)
+    assert not dev.isRunning()
+    dev.startArmed()
+    dev.wait()
+    posTuple = (1.0,2.0,3.0,4.0)
+    dev.armMove(*posTuple)
+    dev.stop()
+    dev.startArmed()
+    assert not dev.isRunning()
+
+def test_isArmed():
+    dev.wait()
+    dev.armMove(1.0,2.0,3.0,4.0)
+    assert dev.isArmed()
+    dev.startArmed()
+    dev.wait()
+    assert not dev.isArmed()
+
+def test_cancelArmed():
+    dev.wait()
+    dev.armMove(1.0,2.0,3.0,4.0)
+    dev.cancelArmed()
+    assert not dev.isArmed()
+    dev.startArmed()
+    assert not dev.isRunning()
+
+def test_setTrigger():
+    dev.setTrigger(21,'R')
+    rsp = dev.getTrigger()
+    print('\ndev.getTrigger() = ')
+    pprint(rsp)
+    assert rsp['pin'] == 21
+    assert rsp['edge'] == 'R'
+    dev.setTrigger(21,'N')
+
 def test_moveAxisToPosition():
     axisDict = dev.getAxisOrder()
     for axisName in axisDict:
         dev.moveAxisToPosition(axisName,1.0)
 
+def test_moveToPositionInTime():
+    posTuple = (1.0,2.0,3.0,4.0)
+    dev.moveToPositionInTime(*(posTuple + (0.5,)))
+    dev.wait()
+    posDict = {'x0':2.0, 'y0': 3.0, 'x1':4.0, 'y1':5.0}
+    dev.moveToPositionInTime(posDict,0.5)
+    dev.wait()
+
+def test_moveArc():
+    dev.setPosition({'x0':50.0, 'y0':50.0, 'x1':150.0, 'y1':150.0})
+    dev.moveArc(0, 40.0, 50.0, 90.0)
+    dev.wait()
+    dev.moveArc(1, 140.0, 150.0, -180.0)
+    dev.wait()
+
+def test_moveBezier():
+    dev.setPosition({'x0':50.0, 'y0':50.0, 'x1':150.0, 'y1':150.0})
+    dev.moveBezier(0, 60.0, 70.0, 80.0, 30.0, 90.0, 50.0)
+    dev.wait()
+    pos = dev.getPosition()
+    stepsPerMM = dev.getStepsPerMM()
+    assert abs(pos['x0'] - 90.0) < 1.0/stepsPerMM
+    assert abs(pos['y0'] - 50.0) < 1.0/stepsPerMM
+
+def test_addPathPoint():
+    dev.setPosition({'x0':50.0, 'y0':50.0, 'x1':150.0, 'y1':150.0})
+    pathList = [
+            (60.0, 50.0, 150.0, 160.0),
+            (60.0, 60.0, 140.0, 160.0),
+            (50.0, 60.0, 140.0, 150.0),
+            (50.0, 50.0, 150.0, 150.0),
+            ]
+    for posTuple in pathList:
+        pathFree = dev.addPathPoint(*posTuple)
+        assert pathFree >= 0
+    dev.wait()
+    pos = dev.getPosition()
+    stepsPerMM = dev.getStepsPerMM()
+    for ax, val in zip(('x0','y0','x1','y1'), pathList[-1]):
+        assert abs(pos[ax] - val) < 1.0/stepsPerMM
+
+def test_getPathFree():
+    pathFree = dev.getPathFree()
+    assert pathFree > 0
+
 def test_moveToHome():
     dev.moveToHome()
 
@@ -151,6 +267,83 @@ def test_getAxisPosition():
         assert type(pos) is float
         print('dev.getAxisPosition({0}) = {1}'.format(ax,pos))
 
+def test_getPositionSteps():
+    posDict = dev.getPositionSteps()
+    axisDict = dev.getAxisOrder()
+    for ax in axisDict:
+        assert ax in posDict
+        assert type(posDict[ax]) in (int,long)
+    print('\ndev.getPositionSteps() = ')
+    pprint(posDict)
+
+def test_getAxisPositionSteps():
+    axisDict = dev.getAxisOrder()
+    stepsDict = dev.getPositionSteps()
+    for ax in axisDict:
+        pos = dev.getAxisPositionSteps(ax)
+        assert pos == stepsDict[ax]
+
+def test_getSnapshot():
+    rsp0 = dev.getSnapshot()
+    print('\ndev.getSnapshot() = ')
+    pprint(rsp0)
+    posDict = dev.getPositionSteps()
+    for ax in posDict:
+        assert rsp0[ax] == posDict[ax]
+    rsp1 = dev.getSnapshot()
+    assert rsp1['tick'] != rsp0['tick']
+
+def test_positionSampler():
+    dev.wait()
+    with PositionSampler(dev,size=1000) as sampler:
+        sampler.moveToPosition(5.0,5.0,5.0,5.0)
+        sampler.wait()
+        samples = sampler.getLast(100)
+        count = sampler.getCount()
+    print('\nsampler.getCount() = {0}'.format(count))
+    assert count > 0
+    assert samples.shape == (min(count,100),5)
+    assert (samples[1:,0] >= samples[:-1,0]).all()
+
+def test_getCaptures():
+    axisDict = dev.getAxisOrder()
+    for ax in axisDict:
+        rsp = dev.getCaptures(ax)
+        print('\ndev.getCaptures({0}) = '.format(ax))
+        pprint(rsp)
+        assert len(rsp['steps']) == len(rsp['time'])
+        assert len(rsp['steps']) == len(rsp['edge'])
+        assert rsp['lost'] >= 0
+
+def test_compareTable():
+    dev.wait()
+    dev.setPosition({'x0':0.0, 'y0':0.0, 'x1':0.0, 'y1':0.0})
+    dev.setCompareOutput(22,100)
+    dev.loadCompareTable('x0',1.0,2.0,3.0)
+    dev.setCompareInterval('y0',0)
+    dev.armCompare()
+    dev.moveToPosition(4.0,0.0,0.0,0.0)
+    dev.wait()
+    rsp = dev.getCompareStatus()
+    print('\ndev.getCompareStatus() = ')
+    pprint(rsp)
+    assert rsp['armed'] == 1
+    assert rsp['pulseCount'] == 3
+    dev.clearCompare()
+    assert dev.getCompareStatus()['armed'] == 0
+
+def test_setPositionMode():
+    stepsPerMM = dev.getStepsPerMM()
+    dev.setPositionMode('float')
+    floatDict = dev.getPosition()
+    dev.setPositionMode('steps')
+    assert dev.getPositionMode() == 'steps'
+    stepsDict = dev.getPosition()
+    for ax in floatDict:
+        assert abs(floatDict[ax] - stepsDict[ax]) < 1.0/stepsPerMM
+        assert abs(dev.getAxisPosition(ax) - floatDict[ax]) < 1.0/stepsPerMM
+    dev.setPositionMode('float')
+
 def test_setPosition():
     stepsPerMM = dev.getStepsPerMM()
     posWrite = {
@@ -193,6 +386,19 @@ def test_setAxisPosition():
         valWrite = posWrite[name]
         valRead = posRead[name]
         assert abs(valWrite - valRead) < 1.0/stepsPerMM 
+
+def test_storedPosition():
+    # Positions are saved once all axes have been set and are at rest
+    dev.wait()
+    dev.setPosition({'x0':10.0, 'y0':20.0, 'x1':30.0, 'y1':40.0})
+    rsp = dev.getStoredPosition()
+    print('\ndev.getStoredPosition() = ')
+    pprint(rsp)
+    assert not rsp['restored']
+    assert not rsp['stale']
+    posDict = dev.getPosition()
+    for ax in posDict:
+        assert abs(rsp[ax] - posDict[ax]) < 1.0e-3
     
 
 
@@ -227,6 +433,34 @@ def test_getSpeed():
     deltaSpeed = abs((speedWrite - speedRead)/speedWrite)
     assert deltaSpeed < TEST_FLOAT_PREC
    
+def test_setFeedOverride():
+    dev.setFeedOverride(50)
+    rsp = dev.getFeedOverride()
+    assert rsp['feedOverrideTarget'] == 50
+    dev.setFeedOverride(100)
+    rsp = dev.getFeedOverride()
+    assert rsp['feedOverrideTarget'] == 100
+
+def test_setAcceleration():
+    dev.setAcceleration(200.0)
+
+def test_getAcceleration():
+    accelWrite = 150.0
+    dev.setAcceleration(accelWrite)
+    accelRead = dev.getAcceleration()
+    deltaAccel = abs((accelWrite - accelRead)/accelWrite)
+    assert deltaAccel < TEST_FLOAT_PREC
+
+def test_setJunctionDeviation():
+    dev.setJunctionDeviation(0.05)
+
+def test_getJunctionDeviation():
+    deviationWrite = 0.1
+    dev.setJunctionDeviation(deviationWrite)
+    deviationRead = dev.getJunctionDeviation()
+    deltaDeviation = abs((deviationWrite - deviationRead)/deviationWrite)
+    assert deltaDeviation < TEST_FLOAT_PREC
+   
 def test_getOrientation():
     allowedOrientation = dev.getAllowedOrientation()
     orientDict = dev.getOrientation()
@@ -302,6 +536,27 @@ def test_getModelNumber():
     rsp = dev.getModelNumber()
     print('\ndev.getModelNumber = {0}'.format(rsp))
 
+def test_getSerialStats():
+    rsp = dev.getSerialStats()
+    print('\ndev.getSerialStats() = ')
+    pprint(rsp)
+    assert rsp['txFree'] > 0
+    assert rsp['txPriorityDropped'] == 0
+    assert rsp['frameNak'] == 0
+
+def test_getCmdArgs():
+    rsp = dev.getCmdArgs()
+    print('\ndev.getCmdArgs() = ')
+    pprint(rsp)
+    assert sorted(rsp.keys()) == sorted(dev.cmdDict.keys())
+    assert rsp['moveToPosition'] == 'f'*dev.getNumAxis()
+    badArgs = False
+    try:
+        dev.moveAxisToPosition('x0','abc')
+    except IOError:
+        badArgs = True
+    assert badArgs
+
 def test_debug():
     rsp = dev.cmdDebug()
     print('\ndev.getDebug() = ')
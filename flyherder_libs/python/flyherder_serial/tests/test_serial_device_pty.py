@@ -0,0 +1,233 @@
+"""
+Tests of SerialDevice's low latency and framed modes against a pty stand-in
+for the device - no hardware is needed. The stand-in answers commands the 
+way the firmware does, one JSON line per command, and can split replies 
+across writes or precede them with event lines. Framed commands are checked,
+replayed and refused as in the firmware's FrameLink, and their replies can be
+corrupted or dropped.
+"""
+from __future__ import print_function
+import os
+import pty
+import json
+import time
+import threading
+from flyherder_serial.serial_device import SerialDevice
+from flyherder_serial.serial_device import frameCrc
+
+class PtyDevice(threading.Thread):
+
+    MODEL_NUMBER = 1105
+    SERIAL_NUMBER = 1
+    WRITE_SPLIT_DT = 0.005
+
+    def __init__(self):
+        super(PtyDevice,self).__init__()
+        self.daemon = True
+        self.masterFd, slaveFd = pty.openpty()
+        self.port = os.ttyname(slaveFd)
+        self.slaveFd = slaveFd
+        self.splitReplies = False
+        self.eventsBefore = []
+        self.cmdCount = 0
+        self.corruptCmds = 0
+        self.corruptReplies = 0
+        self.dropReplies = 0
+        self.lastSeq = 0
+        self.lastReply = None
+        self.start()
+
+    def close(self):
+        os.close(self.masterFd)
+        os.close(self.slaveFd)
+
+    def run(self):
+        buf = ''
+        while True:
+            try:
+                data = os.read(self.masterFd,256)
+            except OSError:
+                return
+            if not data:
+                return
+            buf += data
+            while True:
+                if buf.startswith('#'):
+                    if not '\n' in buf:
+                        break
+                    n = buf.index('\n')
+                    frame, buf = buf[1:n], buf[n+1:]
+                    self.replyFramed(frame)
+                elif ']' in buf:
+                    n = buf.index(']')
+                    cmdStr, buf = buf[:n+1], buf[n+1:]
+                    self.write(self.reply(cmdStr[cmdStr.index('['):]))
+                else:
+                    break
+
+    def replyFramed(self,frame):
+        if self.corruptCmds > 0:
+            self.corruptCmds -= 1
+            frame = frame[:3] + 'x' + frame[4:]
+        body, crc = frame[:-5], frame[-4:]
+        if frameCrc(body) != int(crc,16):
+            self.write('#!\r\n')
+            return
+        seq = int(body[:2],16)
+        eventStr = ''
+        if seq == 0 or seq != self.lastSeq:
+            lines = self.reply(body[2:]).splitlines(True)
+            eventStr = ''.join(lines[:-1])
+            rspStr = lines[-1].strip()
+            self.lastSeq = seq
+            self.lastReply = '#{0:02X}{1}*{2:04X}\r\n'.format(
+                    seq,rspStr,frameCrc('{0:02X}{1}'.format(seq,rspStr))
+                    )
+        rspStr = self.lastReply
+        if self.dropReplies > 0:
+            self.dropReplies -= 1
+            return
+        if self.corruptReplies > 0:
+            self.corruptReplies -= 1
+            rspStr = rspStr.replace('status','stAtus')
+        self.write(eventStr + rspStr)
+
+    def reply(self,cmdStr):
+        args = cmdStr[1:-1].split(',')
+        cmdId = int(args[0])
+        self.cmdCount += 1
+        rspDict = {'cmdId': cmdId, 'status': 1}
+        if cmdId == SerialDevice.CMD_GET_DEV_INFO:
+            rspDict['ModelNumber'] = PtyDevice.MODEL_NUMBER
+            rspDict['SerialNumber'] = PtyDevice.SERIAL_NUMBER
+        else:
+            rspDict['args'] = args[1:]
+        lines = [json.dumps({'event': name}) + '\n' for name in self.eventsBefore]
+        self.eventsBefore = []
+        lines.append(json.dumps(rspDict) + '\n')
+        return ''.join(lines)
+
+    def write(self,rspStr):
+        if self.splitReplies:
+            n = len(rspStr)//2
+            os.write(self.masterFd,rspStr[:n])
+            time.sleep(PtyDevice.WRITE_SPLIT_DT)
+            os.write(self.masterFd,rspStr[n:])
+        else:
+            os.write(self.masterFd,rspStr)
+
+
+def openDevice(ptyDev,framed=False):
+    return SerialDevice(
+            port=ptyDev.port,
+            baudrate=115200,
+            timeout=1.0,
+            reset=False,
+            lowLatency=True,
+            framed=framed,
+            )
+
+def test_lowLatencyOpen():
+    ptyDev = PtyDevice()
+    dev = openDevice(ptyDev)
+    # A pty has no serial driver or usb adapter behind it
+    assert dev.lowLatency
+    assert dev.lowLatencyDict == {'asyncLowLatency': False, 'latencyTimer': False}
+    infoDict = dev.getDeviceInfoDict()
+    assert infoDict['ModelNumber'] == PtyDevice.MODEL_NUMBER
+    dev.close()
+    ptyDev.close()
+
+def test_splitReplies():
+    ptyDev = PtyDevice()
+    dev = openDevice(ptyDev)
+    ptyDev.splitReplies = True
+    for i in range(10):
+        rspDict = dev.sendCmd(5,i)
+        assert rspDict['args'] == [str(i)]
+    dev.close()
+    ptyDev.close()
+
+def test_eventsBeforeReply():
+    ptyDev = PtyDevice()
+    dev = openDevice(ptyDev)
+    ptyDev.eventsBefore = ['driveReady', 'emergencyStop']
+    rspDict = dev.sendCmd(7)
+    assert rspDict['args'] == []
+    assert dev.getEvents() == ['driveReady', 'emergencyStop']
+    assert dev.rxBuf == ''
+    dev.close()
+    ptyDev.close()
+
+def test_cmdTimeStats():
+    ptyDev = PtyDevice()
+    dev = openDevice(ptyDev)
+    dev.resetCmdTimeStats()
+    num = 20
+    for i in range(num):
+        dev.sendCmd(3)
+    statsDict = dev.getCmdTimeStats()
+    print('\ndev.getCmdTimeStats() = {0}'.format(statsDict))
+    stats = statsDict[3]
+    assert stats['count'] == num
+    assert 0.0 < stats['min'] <= stats['mean'] <= stats['max']
+    dev.close()
+    ptyDev.close()
+
+def test_framedCmds():
+    ptyDev = PtyDevice()
+    dev = openDevice(ptyDev,framed=True)
+    ptyDev.eventsBefore = ['driveReady']
+    for i in range(300):
+        rspDict = dev.sendCmd(5,i)
+        assert rspDict['args'] == [str(i)]
+    assert ptyDev.cmdCount == 301
+    assert dev.getEvents() == ['driveReady']
+    assert dev.frameStats['retries'] == 0
+    dev.close()
+    ptyDev.close()
+
+def test_framedCorruptReply():
+    ptyDev = PtyDevice()
+    dev = openDevice(ptyDev,framed=True)
+    dev.sendCmd(3)
+    ptyDev.corruptReplies = 2
+    rspDict = dev.sendCmd(5,1)
+    assert rspDict['args'] == ['1']
+    # Replayed, not run again
+    assert ptyDev.cmdCount == 3
+    assert dev.frameStats['crcErrors'] == 2
+    assert dev.frameStats['retries'] == 2
+    dev.close()
+    ptyDev.close()
+
+def test_framedCorruptCmd():
+    ptyDev = PtyDevice()
+    dev = openDevice(ptyDev,framed=True)
+    ptyDev.corruptCmds = 1
+    rspDict = dev.sendCmd(5,2)
+    assert rspDict['args'] == ['2']
+    assert ptyDev.cmdCount == 2
+    assert dev.frameStats['nak'] == 1
+    dev.close()
+    ptyDev.close()
+
+def test_framedLostReply():
+    ptyDev = PtyDevice()
+    dev = openDevice(ptyDev,framed=True)
+    dev.timeout = 0.1
+    dev.sendCmd(3)
+    ptyDev.dropReplies = 1
+    rspDict = dev.sendCmd(5,3)
+    assert rspDict['args'] == ['3']
+    assert ptyDev.cmdCount == 3
+    assert dev.frameStats['timeouts'] == 1
+    ptyDev.dropReplies = dev.frameRetries + 1
+    try:
+        dev.sendCmd(5,4)
+    except IOError:
+        pass
+    else:
+        assert False, 'IOError not raised'
+    dev.close()
+    ptyDev.close()